@@ -0,0 +1,264 @@
+/**
+ * bench.hpp: Minimal micro-benchmark harness (rdtsc timing, outlier rejection, text/CSV/JSON output).
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef bench_hpp__9F1C7A52_3E0B_4D6B_8B55_1D2E7F4A6C39
+#define bench_hpp__9F1C7A52_3E0B_4D6B_8B55_1D2E7F4A6C39  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "perf_counters.hpp"
+
+#if defined (_MSC_VER)
+#   include <intrin.h>
+#elif defined (__x86_64__) || defined (__i386__)
+#   include <x86intrin.h>
+#endif
+
+namespace Bench {
+
+    /// Keeps `value` alive (prevents the compiler from discarding the computation).
+    template <typename T_>
+        inline void do_not_optimize (const T_ &value) {
+#if defined (_MSC_VER)
+            _ReadWriteBarrier () ;
+            (void)value ;
+#else
+            __asm__ __volatile__ ("" : : "r,m" (value) : "memory") ;
+#endif
+        }
+
+    /// Reads the time stamp counter (falls back to nanoseconds on non-x86 targets).
+    inline uint64_t rdtsc () {
+#if defined (_MSC_VER) || defined (__x86_64__) || defined (__i386__)
+        _mm_lfence () ;
+        const uint64_t  v = __rdtsc () ;
+        _mm_lfence () ;
+        return v ;
+#else
+        return static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::steady_clock::now ().time_since_epoch ()).count ()) ;
+#endif
+    }
+
+    enum class format_t { TEXT, CSV, JSON } ;
+
+    struct options_t {
+        size_t      warmup = 3 ;        ///< # of discarded runs before measuring.
+        size_t      repetitions = 31 ;  ///< # of measured runs.
+        double      scale = 1.0 ;       ///< Scales the # of operations in a run.
+        size_t      threads = 0 ;       ///< Max. # of threads for multi-threaded modes (0: all hardware threads).
+        int         load = -1 ;         ///< # of background load threads for latency modes (-1: all but one hardware threads).
+        bool        perf = true ;       ///< Reads hardware counters around each measured run (when available).
+        format_t    format = format_t::TEXT ;
+    } ;
+
+    struct result_t {
+        std::string group ;
+        std::string name ;
+        size_t      ops = 0 ;           ///< # of operations per run.
+        size_t      repetitions = 0 ;
+        size_t      outliers = 0 ;      ///< # of runs rejected as outliers.
+        double      cycles = 0 ;        ///< Median TSC cycles per operation.
+        double      ns = 0 ;            ///< Median nanoseconds per operation.
+        double      min_cycles = 0 ;    ///< Fastest run (TSC cycles per operation).
+        std::vector<std::pair<std::string, double>> extra ;  ///< Mode specific metrics.
+
+        result_t &  add (const std::string &key, double value) {
+            extra.emplace_back (key, value) ;
+            return *this ;
+        }
+
+        /// The metric named `key` (`fallback` when absent).
+        double      get (const std::string &key, double fallback = 0) const {
+            for (const auto &kv : extra) {
+                if (kv.first == key) {
+                    return kv.second ;
+                }
+            }
+            return fallback ;
+        }
+    } ;
+
+    /// Figures derived from several results (reported apart from the measurements, they have no cost of their own).
+    struct summary_t {
+        std::string group ;
+        std::string name ;
+        std::vector<std::pair<std::string, double>> values ;
+
+        summary_t & add (const std::string &key, double value) {
+            values.emplace_back (key, value) ;
+            return *this ;
+        }
+    } ;
+
+    /// Per-run raw measurement.
+    struct sample_t {
+        uint64_t    cycles ;
+        uint64_t    ns ;
+    } ;
+
+    namespace detail {
+        inline double   median (std::vector<double> v) {
+            if (v.empty ()) {
+                return 0 ;
+            }
+            std::sort (v.begin (), v.end ()) ;
+            const size_t    n = v.size () ;
+            return (n & 1) != 0 ? v [n / 2] : 0.5 * (v [n / 2 - 1] + v [n / 2]) ;
+        }
+    }
+
+    /**
+     * Summarizes raw samples.
+     * Runs farther than 3 scaled MADs above the median (interrupts, migrations...) are rejected.
+     */
+    inline result_t summarize (const std::string &group, const std::string &name, size_t ops, const std::vector<sample_t> &samples) {
+        result_t    result ;
+        result.group = group ;
+        result.name = name ;
+        result.ops = ops ;
+        result.repetitions = samples.size () ;
+
+        std::vector<double> cycles ;
+        for (const auto &s : samples) {
+            cycles.push_back (static_cast<double> (s.cycles)) ;
+        }
+        const double    med = detail::median (cycles) ;
+        std::vector<double> deviations ;
+        for (auto c : cycles) {
+            deviations.push_back (std::fabs (c - med)) ;
+        }
+        const double    limit = med + 3.0 * 1.4826 * detail::median (deviations) ;
+
+        std::vector<double> kept_cycles ;
+        std::vector<double> kept_ns ;
+        for (const auto &s : samples) {
+            if (static_cast<double> (s.cycles) <= limit) {
+                kept_cycles.push_back (static_cast<double> (s.cycles)) ;
+                kept_ns.push_back (static_cast<double> (s.ns)) ;
+            }
+        }
+        const double    n = static_cast<double> (ops == 0 ? 1 : ops) ;
+        result.outliers = samples.size () - kept_cycles.size () ;
+        result.cycles = detail::median (kept_cycles) / n ;
+        result.ns = detail::median (kept_ns) / n ;
+        result.min_cycles = kept_cycles.empty () ? 0 : *std::min_element (kept_cycles.begin (), kept_cycles.end ()) / n ;
+        return result ;
+    }
+
+    /**
+     * Measures `fn`, which should perform `ops` operations per call.
+     * Hardware counters (per op) and IPC are appended to the result when `opt.perf` is set and the host allows.
+     */
+    template <typename F_>
+        result_t    measure (const std::string &group, const std::string &name, size_t ops, const options_t &opt, F_ &&fn) {
+            for (size_t i = 0 ; i < opt.warmup ; ++i) {
+                fn () ;
+            }
+            perf_counters_t *   counters = nullptr ;
+            if (opt.perf && perf_counters_t::thread_instance ().any_available ()) {
+                counters = &perf_counters_t::thread_instance () ;
+            }
+            perf_counters_t::values_t   totals ;
+            totals.fill (0) ;
+
+            std::vector<sample_t>   samples ;
+            samples.reserve (opt.repetitions) ;
+            for (size_t i = 0 ; i < opt.repetitions ; ++i) {
+                if (counters != nullptr) {
+                    counters->start () ;
+                }
+                const auto      t0 = std::chrono::steady_clock::now () ;
+                const uint64_t  c0 = rdtsc () ;
+                fn () ;
+                const uint64_t  c1 = rdtsc () ;
+                const auto      t1 = std::chrono::steady_clock::now () ;
+                if (counters != nullptr) {
+                    const auto  values = counters->stop () ;
+                    for (size_t k = 0 ; k < values.size () ; ++k) {
+                        totals [k] += values [k] ;
+                    }
+                }
+                samples.push_back (sample_t { c1 - c0, static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (t1 - t0).count ()) }) ;
+            }
+            auto    result = summarize (group, name, ops, samples) ;
+            if (counters != nullptr) {
+                const double    n = static_cast<double> (std::max<size_t> (1, ops * opt.repetitions)) ;
+                for (size_t k = 0 ; k < totals.size () ; ++k) {
+                    const auto  c = static_cast<perf_counters_t::counter_t> (k) ;
+                    if (counters->available (c)) {
+                        result.add (std::string { perf_counters_t::name_of (c) } + "_per_op", static_cast<double> (totals [k]) / n) ;
+                    }
+                }
+                if (counters->available (perf_counters_t::CYCLES) && counters->available (perf_counters_t::INSTRUCTIONS) && 0 < totals [perf_counters_t::CYCLES]) {
+                    result.add ("ipc", static_cast<double> (totals [perf_counters_t::INSTRUCTIONS]) / static_cast<double> (totals [perf_counters_t::CYCLES])) ;
+                }
+            }
+            return result ;
+        }
+
+    /// Collects results and writes them in the requested format.
+    class reporter_t {
+    private:
+        format_t                format_ ;
+        std::vector<result_t>   results_ ;
+        std::vector<summary_t>  summaries_ ;
+    public:
+        explicit reporter_t (format_t fmt) : format_ (fmt) {
+            /* NO-OP */
+        }
+
+        void    add (const result_t &result) {
+            results_.push_back (result) ;
+        }
+
+        void    add (const summary_t &summary) {
+            summaries_.push_back (summary) ;
+        }
+
+        const std::vector<result_t> &   results () const {
+            return results_ ;
+        }
+
+        const std::vector<summary_t> &  summaries () const {
+            return summaries_ ;
+        }
+
+        void    write (std::ostream &out) const ;
+    } ;
+
+    /// Benchmark mode (a group of related measurements selectable from the command line).
+    struct mode_t {
+        const char *    name ;
+        const char *    description ;
+        std::function<void (const options_t &, reporter_t &)>  run ;
+    } ;
+
+    std::vector<mode_t> &   modes () ;
+
+    /// Registers a mode at static initialization time.
+    struct registrar_t {
+        registrar_t (const char *name, const char *description, std::function<void (const options_t &, reporter_t &)> run) {
+            modes ().push_back (mode_t { name, description, std::move (run) }) ;
+        }
+    } ;
+
+    /// Scales the default # of operations by `--scale`.
+    inline size_t   scaled (const options_t &opt, size_t ops) {
+        return std::max<size_t> (1, static_cast<size_t> (static_cast<double> (ops) * opt.scale)) ;
+    }
+}
+
+#endif /* bench_hpp__9F1C7A52_3E0B_4D6B_8B55_1D2E7F4A6C39 */
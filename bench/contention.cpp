@@ -0,0 +1,171 @@
+/*
+ * contention.cpp: Scaling of the shared lock-free generator against per-thread and batched alternatives.
+ */
+#include "threads.hpp"
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+#include "block_dispenser.hpp"
+#include "contention.hpp"
+#include "engine.hpp"
+#include "xoroshiro.hpp"
+#include "xoroshiro_tls.hpp"
+
+namespace {
+
+    struct alignas (XORSHIFT_CACHE_LINE_SIZE) padded_state_t {
+        XoRoShiRo::state_t  state ;
+    } ;
+
+    using dispenser_t = XoRoShiRo::block_dispenser<512, 64> ;
+
+    void    run_contention (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+        const std::string   group { "contention" } ;
+        const size_t        N = Bench::scaled (opt, 200000) ;  // Per thread.
+
+        // Throughput (Mops/s) of each variant, keyed by # of threads.
+        std::map<std::string, std::map<size_t, double>> throughput ;
+        auto    record = [&](Bench::result_t result) {
+            throughput [result.name][static_cast<size_t> (result.get ("threads"))] = result.get ("mops_per_sec") ;
+            reporter.add (result) ;
+        } ;
+
+        for (size_t T : Bench::thread_counts (opt)) {
+            const size_t    ops = T * N ;
+
+#if XOROSHIRO_LOCKFREE
+            {
+                padded_state_t  shared { { 0, 1 } } ;
+                record (Bench::measure_parallel (group, "shared/next", T, ops, opt, [&shared, N](size_t) {
+                    uint64_t    sum = 0 ;
+                    for (size_t i = 0 ; i < N ; ++i) {
+                        sum += XoRoShiRo::next (shared.state) ;
+                    }
+                    Bench::do_not_optimize (sum) ;
+                })) ;
+            }
+#endif
+#if CONTENTION_AVAILABLE
+            for (const auto &variant : { std::make_pair ("shared/next+stats", Contention::backoff_t { 0, 0 })
+                                       , std::make_pair ("shared/next+backoff", Contention::backoff_t {}) }) {
+                padded_state_t  shared { { 0, 1 } } ;
+                const auto      backoff = variant.second ;
+                const auto      before = Contention::total_stats () ;
+                std::atomic<uint64_t>   max_retries { 0 } ;     // Longest streak within a single run.
+                auto    result = Bench::measure_parallel (group, variant.first, T, ops, opt, [&shared, &backoff, &max_retries, N](size_t) {
+                    uint64_t    sum = 0 ;
+                    for (size_t i = 0 ; i < N ; ++i) {
+                        sum += XoRoShiRo::next (shared.state, backoff) ;
+                    }
+                    Bench::do_not_optimize (sum) ;
+                    // Every run starts fresh threads, so the thread's counters cover this run alone.
+                    const uint64_t  streak = Contention::thread_stats ().max_retries ;
+                    uint64_t        m = max_retries.load () ;
+                    while (m < streak && ! max_retries.compare_exchange_weak (m, streak)) {
+                        /* retry */
+                    }
+                }) ;
+                const auto      after = Contention::total_stats () ;
+                const double    calls = static_cast<double> (after.calls - before.calls) ;
+                result.add ("retries_per_success", calls == 0 ? 0.0 : static_cast<double> (after.retries - before.retries) / calls) ;
+                result.add ("max_retries", static_cast<double> (max_retries.load ())) ;
+                record (result) ;
+            }
+            {
+                std::unique_ptr<padded_state_t []>  shards { new padded_state_t [T] } ;
+                XoRoShiRo::state_t  S { 0, 1 } ;
+                for (size_t t = 0 ; t < T ; ++t) {
+                    shards [t].state = S ;
+                    XoRoShiRo::unsafe_jump (S) ;
+                }
+                record (Bench::measure_parallel (group, "sharded/next", T, ops, opt, [&shards, N](size_t tid) {
+                    uint64_t    sum = 0 ;
+                    for (size_t i = 0 ; i < N ; ++i) {
+                        sum += XoRoShiRo::next (shards [tid].state, Contention::backoff_t {}) ;
+                    }
+                    Bench::do_not_optimize (sum) ;
+                })) ;
+            }
+#endif
+            {
+                std::unique_ptr<dispenser_t>    dispenser { new dispenser_t } ;
+                record (Bench::measure_parallel (group, "batched/dispenser", T, ops, opt, [&dispenser, N](size_t tid) {
+                    // Consumers refill the queue themselves, from their own jump-separated streams.
+                    XoRoShiRo::state_t  S { 0, 1 } ;
+                    for (size_t i = 0 ; i < tid ; ++i) {
+                        XoRoShiRo::unsafe_jump (S) ;
+                    }
+                    uint64_t    sum = 0 ;
+                    for (size_t i = 0 ; i < N ; i += dispenser_t::BLOCK_SIZE) {
+                        while (! dispenser->consume_in_place ([&sum](const uint64_t *blk) {
+                                    for (size_t k = 0 ; k < dispenser_t::BLOCK_SIZE ; ++k) {
+                                        sum += blk [k] ;
+                                    }
+                                })) {
+                            dispenser->produce (S) ;
+                        }
+                    }
+                    Bench::do_not_optimize (sum) ;
+                })) ;
+            }
+            {
+                std::unique_ptr<Engine::xoroshiro128_plus<Engine::threading::wait_free>>    shared { new Engine::xoroshiro128_plus<Engine::threading::wait_free> { XoRoShiRo::state_t { 0, 1 } } } ;
+                record (Bench::measure_parallel (group, "shared/wait_free", T, ops, opt, [&shared, N](size_t) {
+                    uint64_t    sum = 0 ;
+                    for (size_t i = 0 ; i < N ; ++i) {
+                        sum += (*shared) () ;
+                    }
+                    Bench::do_not_optimize (sum) ;
+                })) ;
+            }
+            record (Bench::measure_parallel (group, "tls/unsafe_next", T, ops, opt, [N](size_t) {
+                uint64_t    sum = 0 ;
+                for (size_t i = 0 ; i < N ; ++i) {
+                    sum += XoRoShiRo::thread_next () ;
+                }
+                Bench::do_not_optimize (sum) ;
+            })) ;
+        }
+
+        // Where the shared generator stops scaling, and where each alternative overtakes it.
+        const auto  base = throughput.find ("shared/next") ;
+        if (base == throughput.end ()) {
+            return ;
+        }
+        Bench::summary_t    peak ;
+        peak.group = group ;
+        peak.name = "shared/next/peak" ;
+        size_t  peak_threads = 0 ;
+        double  peak_mops = 0 ;
+        for (const auto &kv : base->second) {
+            if (peak_threads == 0 || peak_mops < kv.second) {
+                peak_threads = kv.first ;
+                peak_mops = kv.second ;
+            }
+        }
+        peak.add ("threads", static_cast<double> (peak_threads)).add ("mops_per_sec", peak_mops) ;
+        reporter.add (peak) ;
+        for (const auto &variant : throughput) {
+            if (variant.first == base->first) {
+                continue ;
+            }
+            Bench::summary_t    crossover ;
+            crossover.group = group ;
+            crossover.name = "crossover/" + variant.first ;
+            double  threads = 0 ;  // 0: Never overtakes within the measured range.
+            for (const auto &kv : variant.second) {
+                if (base->second [kv.first] < kv.second) {
+                    threads = static_cast<double> (kv.first) ;
+                    break ;
+                }
+            }
+            crossover.add ("threads", threads) ;
+            reporter.add (crossover) ;
+        }
+    }
+
+    Bench::registrar_t  contention { "contention", "Throughput of 1..N pinned threads sharing one state vs. sharded, batched and thread-local streams"
+                                   , run_contention } ;
+}
@@ -0,0 +1,140 @@
+/*
+ * engines.cpp: Same workloads through the library's generators and the standard engines.
+ */
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "engine.hpp"
+#include "xorshift.hpp"
+#include "xoroshiro.hpp"
+
+namespace {
+
+    /// UniformRandomBitGenerator adaptor over the thread agnostic `unsafe_next`.
+    template <typename STATE_, uint64_t (*NEXT_) (STATE_ &)>
+        class urbg_t {
+        private:
+            STATE_  state_ ;
+        public:
+            using result_type = uint64_t ;
+
+            urbg_t () : state_ { { 0x9E3779B97F4A7C15ull, 0xBF58476D1CE4E5B9ull } } {
+                /* NO-OP */
+            }
+
+            static constexpr result_type    min () { return 0 ; }
+            static constexpr result_type    max () { return std::numeric_limits<result_type>::max () ; }
+
+            result_type operator () () {
+                return NEXT_ (state_) ;
+            }
+        } ;
+
+    using xorshift_urbg = urbg_t<XorShift::state_t, XorShift::unsafe_next> ;
+    using xoroshiro_urbg = urbg_t<XoRoShiRo::state_t, XoRoShiRo::unsafe_next> ;
+
+    /// SplitMix64 (http://xoroshiro.di.unimi.it/splitmix64.c)
+    class splitmix64 {
+    private:
+        uint64_t    x_ = 0x9E3779B97F4A7C15ull ;
+    public:
+        using result_type = uint64_t ;
+
+        static constexpr result_type    min () { return 0 ; }
+        static constexpr result_type    max () { return std::numeric_limits<result_type>::max () ; }
+
+        result_type operator () () {
+            uint64_t    z = (x_ += 0x9E3779B97F4A7C15ull) ;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull ;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull ;
+            return z ^ (z >> 31) ;
+        }
+    } ;
+
+    /// # of random bytes an engine delivers per call.
+    template <typename E_>
+        double  bytes_per_value () {
+            const double    range = static_cast<double> (E_::max () - E_::min ()) + 1.0 ;
+            return std::log2 (range) / 8.0 ;
+        }
+
+    template <typename E_>
+        void    run_engine (const char *name, const Bench::options_t &opt, Bench::reporter_t &reporter) {
+            const std::string   group { name } ;
+            const size_t        N = Bench::scaled (opt, 100000) ;
+            E_  engine ;
+
+            // Random bytes drawn from the engine per cycle (raw), or bytes of distribution output per cycle:
+            // A distribution may draw more (or fewer) bits than it returns, e.g. `bounded/1000` takes
+            // a 64-bit draw (or more, when it rejects) per 32-bit value.
+            auto    add = [&reporter](Bench::result_t result, const char *metric, double bytes) {
+                result.add (metric, result.cycles <= 0 ? 0.0 : bytes / result.cycles) ;
+                reporter.add (result) ;
+            } ;
+
+            add (Bench::measure (group, "raw", N, opt, [&engine, N]() {
+                typename E_::result_type    sum = 0 ;
+                for (size_t i = 0 ; i < N ; ++i) {
+                    sum += engine () ;
+                }
+                Bench::do_not_optimize (sum) ;
+            }), "bytes_per_cycle", bytes_per_value<E_> ()) ;
+
+            add (Bench::measure (group, "bounded/1000", N, opt, [&engine, N]() {
+                std::uniform_int_distribution<uint32_t> dist { 0, 999 } ;
+                uint32_t    sum = 0 ;
+                for (size_t i = 0 ; i < N ; ++i) {
+                    sum += dist (engine) ;
+                }
+                Bench::do_not_optimize (sum) ;
+            }), "output_bytes_per_cycle", sizeof (uint32_t)) ;
+
+            add (Bench::measure (group, "double", N, opt, [&engine, N]() {
+                std::uniform_real_distribution<double>  dist { 0.0, 1.0 } ;
+                double  sum = 0 ;
+                for (size_t i = 0 ; i < N ; ++i) {
+                    sum += dist (engine) ;
+                }
+                Bench::do_not_optimize (sum) ;
+            }), "output_bytes_per_cycle", sizeof (double)) ;
+
+            add (Bench::measure (group, "normal", N, opt, [&engine, N]() {
+                std::normal_distribution<double>    dist { 0.0, 1.0 } ;
+                double  sum = 0 ;
+                for (size_t i = 0 ; i < N ; ++i) {
+                    sum += dist (engine) ;
+                }
+                Bench::do_not_optimize (sum) ;
+            }), "output_bytes_per_cycle", sizeof (double)) ;
+
+            std::vector<uint32_t>   deck (1024) ;
+            std::iota (deck.begin (), deck.end (), 0) ;
+            const size_t    R = std::max<size_t> (1, N / deck.size ()) ;
+            add (Bench::measure (group, "shuffle/1024", R * deck.size (), opt, [&engine, &deck, R]() {
+                for (size_t i = 0 ; i < R ; ++i) {
+                    std::shuffle (deck.begin (), deck.end (), engine) ;
+                    Bench::do_not_optimize (deck [0]) ;
+                }
+            }), "output_bytes_per_cycle", sizeof (uint32_t)) ;
+        }
+
+    void    run_engines (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+        run_engine<xorshift_urbg> ("xorshift128+", opt, reporter) ;
+        run_engine<xoroshiro_urbg> ("xoroshiro128+", opt, reporter) ;
+        run_engine<Engine::xoroshiro128_plus<>> ("engine/xoroshiro128+", opt, reporter) ;
+        run_engine<Engine::xoroshiro128_star_star<>> ("engine/xoroshiro128**", opt, reporter) ;
+        run_engine<Engine::xoroshiro128_plus_plus<>> ("engine/xoroshiro128++", opt, reporter) ;
+        run_engine<splitmix64> ("splitmix64", opt, reporter) ;
+        run_engine<std::mt19937_64> ("mt19937_64", opt, reporter) ;
+        run_engine<std::minstd_rand> ("minstd_rand", opt, reporter) ;
+    }
+
+    Bench::registrar_t  engines { "engines", "xorshift128+/xoroshiro128+ vs. SplitMix64, mt19937_64 and minstd_rand on common workloads"
+                                , run_engines } ;
+}
@@ -0,0 +1,154 @@
+/*
+ * entry_points.cpp: Cost of every generator entry point (single values, bulk fills and jumps).
+ */
+#include "bench.hpp"
+
+#include <array>
+#include <vector>
+
+#include "substream.hpp"
+#include "xorshift.hpp"
+#include "xoroshiro.hpp"
+
+namespace {
+
+    struct xorshift_t {
+        using state_t = XorShift::state_t ;
+        static const char * name () { return "xorshift128+" ; }
+        static uint64_t unsafe_next (state_t &S) { return XorShift::unsafe_next (S) ; }
+        static void     unsafe_jump (state_t &S) { XorShift::unsafe_jump (S) ; }
+        static void     unsafe_fill (state_t &S, uint64_t *out, size_t n) { XorShift::unsafe_fill (S, out, n) ; }
+        template <size_t L_>
+            static void unsafe_fill_interleaved (std::array<state_t, L_> &S, uint64_t *out, size_t rounds) { XorShift::unsafe_fill_interleaved (S, out, rounds) ; }
+#if XORSHIFT_LOCKFREE
+        static uint64_t next (state_t &S) { return XorShift::next (S) ; }
+        static void     jump (state_t &S) { XorShift::jump (S) ; }
+#endif
+#if CONTENTION_AVAILABLE
+        static state_t  take_stream (state_t &S) { return XorShift::take_stream (S) ; }
+#endif
+        static constexpr bool   LOCKFREE = XORSHIFT_LOCKFREE != 0 ;
+    } ;
+
+    struct xoroshiro_t {
+        using state_t = XoRoShiRo::state_t ;
+        static const char * name () { return "xoroshiro128+" ; }
+        static uint64_t unsafe_next (state_t &S) { return XoRoShiRo::unsafe_next (S) ; }
+        static void     unsafe_jump (state_t &S) { XoRoShiRo::unsafe_jump (S) ; }
+        static void     unsafe_fill (state_t &S, uint64_t *out, size_t n) { XoRoShiRo::unsafe_fill (S, out, n) ; }
+        template <size_t L_>
+            static void unsafe_fill_interleaved (std::array<state_t, L_> &S, uint64_t *out, size_t rounds) { XoRoShiRo::unsafe_fill_interleaved (S, out, rounds) ; }
+#if XOROSHIRO_LOCKFREE
+        static uint64_t next (state_t &S) { return XoRoShiRo::next (S) ; }
+        static void     jump (state_t &S) { XoRoShiRo::jump (S) ; }
+#endif
+#if CONTENTION_AVAILABLE
+        static state_t  take_stream (state_t &S) { return XoRoShiRo::take_stream (S) ; }
+#endif
+        static constexpr bool   LOCKFREE = XOROSHIRO_LOCKFREE != 0 ;
+    } ;
+
+    template <typename G_, bool LOCKFREE_ = G_::LOCKFREE>
+        struct lockfree_bench {
+            static void run (const Bench::options_t &, Bench::reporter_t &) {
+                /* Lock-free versions are not available.  */
+            }
+        } ;
+
+    template <typename G_>
+        struct lockfree_bench<G_, true> {
+            static void run (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+                const std::string   group { G_::name () } ;
+                alignas (16) typename G_::state_t   S { 0, 1 } ;
+
+                const size_t    N = Bench::scaled (opt, 100000) ;
+                reporter.add (Bench::measure (group, "next", N, opt, [&S, N]() {
+                    uint64_t    sum = 0 ;
+                    for (size_t i = 0 ; i < N ; ++i) {
+                        sum += G_::next (S) ;
+                    }
+                    Bench::do_not_optimize (sum) ;
+                })) ;
+
+                const size_t    J = Bench::scaled (opt, 1000) ;
+                reporter.add (Bench::measure (group, "jump", J, opt, [&S, J]() {
+                    for (size_t i = 0 ; i < J ; ++i) {
+                        G_::jump (S) ;
+                    }
+                    Bench::do_not_optimize (S) ;
+                })) ;
+#if CONTENTION_AVAILABLE
+                reporter.add (Bench::measure (group, "take_stream", J, opt, [&S, J]() {
+                    for (size_t i = 0 ; i < J ; ++i) {
+                        Bench::do_not_optimize (G_::take_stream (S)) ;
+                    }
+                })) ;
+#endif
+            }
+        } ;
+
+    /// Fills of `L_` interleaved lanes (the IPC gain shows up in the perf counters).
+    template <typename G_, size_t L_>
+        void    run_interleaved (const Bench::options_t &opt, Bench::reporter_t &reporter, size_t N) {
+            std::array<typename G_::state_t, L_>    S {} ;
+            for (size_t l = 0 ; l < L_ ; ++l) {
+                S [l] = typename G_::state_t { l, 1 } ;
+            }
+            std::vector<uint64_t>   buf (4096) ;
+            const size_t    rounds = buf.size () / L_ ;
+            const size_t    R = std::max<size_t> (1, N / buf.size ()) ;
+            reporter.add (Bench::measure (G_::name (), "unsafe_fill_interleaved/" + std::to_string (L_), R * rounds * L_, opt, [&S, &buf, R, rounds]() {
+                for (size_t i = 0 ; i < R ; ++i) {
+                    G_::unsafe_fill_interleaved (S, buf.data (), rounds) ;
+                    Bench::do_not_optimize (buf [0]) ;
+                }
+            })) ;
+        }
+
+    template <typename G_>
+        void    run_entry_points (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+            const std::string   group { G_::name () } ;
+            typename G_::state_t    S { 0, 1 } ;
+
+            const size_t    N = Bench::scaled (opt, 100000) ;
+            reporter.add (Bench::measure (group, "unsafe_next", N, opt, [&S, N]() {
+                uint64_t    sum = 0 ;
+                for (size_t i = 0 ; i < N ; ++i) {
+                    sum += G_::unsafe_next (S) ;
+                }
+                Bench::do_not_optimize (sum) ;
+            })) ;
+
+            for (size_t size : { 64u, 512u, 4096u }) {
+                std::vector<uint64_t>   buf (size) ;
+                const size_t    R = std::max<size_t> (1, N / size) ;
+                reporter.add (Bench::measure (group, "unsafe_fill/" + std::to_string (size), R * size, opt, [&S, &buf, R]() {
+                    for (size_t i = 0 ; i < R ; ++i) {
+                        G_::unsafe_fill (S, buf.data (), buf.size ()) ;
+                        Bench::do_not_optimize (buf [0]) ;
+                    }
+                })) ;
+            }
+
+            run_interleaved<G_, 1> (opt, reporter, N) ;
+            run_interleaved<G_, 2> (opt, reporter, N) ;
+            run_interleaved<G_, 4> (opt, reporter, N) ;
+            run_interleaved<G_, 8> (opt, reporter, N) ;
+
+            const size_t    J = Bench::scaled (opt, 1000) ;
+            reporter.add (Bench::measure (group, "unsafe_jump", J, opt, [&S, J]() {
+                for (size_t i = 0 ; i < J ; ++i) {
+                    G_::unsafe_jump (S) ;
+                }
+                Bench::do_not_optimize (S) ;
+            })) ;
+
+            lockfree_bench<G_>::run (opt, reporter) ;
+        }
+
+    Bench::registrar_t  entry_points { "entry", "Single thread cost of every generator entry point"
+                                     , [](const Bench::options_t &opt, Bench::reporter_t &reporter) {
+                                           run_entry_points<xorshift_t> (opt, reporter) ;
+                                           run_entry_points<xoroshiro_t> (opt, reporter) ;
+                                       } } ;
+}
@@ -0,0 +1,98 @@
+/**
+ * histogram.hpp: HDR style log-bucketed histogram of latencies.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef histogram_hpp__D4A27F68_1B9C_4C3E_85A0_6E2B7D19F05B
+#define histogram_hpp__D4A27F68_1B9C_4C3E_85A0_6E2B7D19F05B  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+#include <algorithm>
+
+namespace Bench {
+
+    /**
+     * Each power of 2 range is split into 2^SUB_BITS_ equal buckets,
+     * so any recorded value is reported within 1 / 2^SUB_BITS_ relative error.
+     */
+    template <unsigned SUB_BITS_ = 5>
+        class histogram_t {
+        public:
+            static constexpr uint64_t   SUB_COUNT = 1ull << SUB_BITS_ ;
+            static constexpr size_t     NUM_BUCKETS = (64 - SUB_BITS_ + 1) * SUB_COUNT ;
+        private:
+            std::array<uint64_t, NUM_BUCKETS>   counts_ ;
+            uint64_t    total_ = 0 ;
+            uint64_t    max_ = 0 ;
+
+            static unsigned msb (uint64_t v) {
+#if defined (__GNUC__)
+                return 63u - static_cast<unsigned> (__builtin_clzll (v)) ;
+#else
+                unsigned    result = 0 ;
+                while ((v >>= 1) != 0) {
+                    ++result ;
+                }
+                return result ;
+#endif
+            }
+
+            static size_t   index_of (uint64_t v) {
+                if (v < SUB_COUNT) {
+                    return static_cast<size_t> (v) ;
+                }
+                const unsigned  shift = msb (v) - SUB_BITS_ ;
+                return static_cast<size_t> ((shift + 1) * SUB_COUNT + ((v >> shift) - SUB_COUNT)) ;
+            }
+
+            /// Highest value that falls into the bucket `idx`.
+            static uint64_t upper_bound_of (size_t idx) {
+                if (idx < SUB_COUNT) {
+                    return idx ;
+                }
+                const unsigned  shift = static_cast<unsigned> (idx / SUB_COUNT - 1) ;
+                const uint64_t  sub = idx % SUB_COUNT + SUB_COUNT ;
+                return ((sub + 1) << shift) - 1 ;
+            }
+        public:
+            histogram_t () {
+                counts_.fill (0) ;
+            }
+
+            void    record (uint64_t v) {
+                ++counts_ [index_of (v)] ;
+                ++total_ ;
+                max_ = std::max (max_, v) ;
+            }
+
+            uint64_t    count () const {
+                return total_ ;
+            }
+
+            uint64_t    max () const {
+                return max_ ;
+            }
+
+            /// Value at the `p` percentile (0..100).
+            uint64_t    percentile (double p) const {
+                if (total_ == 0) {
+                    return 0 ;
+                }
+                const auto  rank = static_cast<uint64_t> (p / 100.0 * static_cast<double> (total_) + 0.5) ;
+                uint64_t    seen = 0 ;
+                for (size_t i = 0 ; i < NUM_BUCKETS ; ++i) {
+                    seen += counts_ [i] ;
+                    if (rank <= seen && 0 < seen) {
+                        return std::min (upper_bound_of (i), max_) ;
+                    }
+                }
+                return max_ ;
+            }
+        } ;
+}
+
+#endif /* histogram_hpp__D4A27F68_1B9C_4C3E_85A0_6E2B7D19F05B */
@@ -0,0 +1,158 @@
+/*
+ * latency.cpp: Per-call latency distribution of the shared generator under background load.
+ */
+#include "histogram.hpp"
+#include "threads.hpp"
+
+#include "contention.hpp"
+#include "engine.hpp"
+#include "xoroshiro.hpp"
+#include "xoroshiro_tls.hpp"
+
+namespace {
+
+    struct alignas (64) shared_state_t {
+        XoRoShiRo::state_t  state ;
+    } ;
+
+    /// TSC ticks per nanosecond.
+    double  tsc_per_ns () {
+        static const double ratio = []() {
+            const auto      t0 = std::chrono::steady_clock::now () ;
+            const uint64_t  c0 = Bench::rdtsc () ;
+            std::this_thread::sleep_for (std::chrono::milliseconds { 20 }) ;
+            const uint64_t  c1 = Bench::rdtsc () ;
+            const auto      t1 = std::chrono::steady_clock::now () ;
+            const auto      ns = std::chrono::duration_cast<std::chrono::nanoseconds> (t1 - t0).count () ;
+            return ns <= 0 ? 1.0 : static_cast<double> (c1 - c0) / static_cast<double> (ns) ;
+        } () ;
+        return ratio ;
+    }
+
+    /// Cost of an empty timed region (subtracted from every sample).
+    uint64_t    timer_overhead () {
+        static const uint64_t   overhead = []() {
+            uint64_t    best = UINT64_MAX ;
+            for (int i = 0 ; i < 10000 ; ++i) {
+                const uint64_t  c0 = Bench::rdtsc () ;
+                const uint64_t  c1 = Bench::rdtsc () ;
+                best = std::min (best, c1 - c0) ;
+            }
+            return best ;
+        } () ;
+        return overhead ;
+    }
+
+    /// Background load on the shared state.
+    struct hammer_shared {
+        shared_state_t &    shared ;
+
+        uint64_t    operator () () {
+#if XOROSHIRO_LOCKFREE
+            return XoRoShiRo::next (shared.state) ;
+#else
+            return XoRoShiRo::thread_next () ;
+#endif
+        }
+    } ;
+
+    /**
+     * Samples `fn` `count` times on CPU 0 while `load` threads call `hammer` on the other CPUs.
+     */
+    template <typename H_, typename F_>
+        Bench::result_t sample (const std::string &name, size_t count, size_t load, H_ hammer, F_ &&fn) {
+            std::atomic<bool>           running { true } ;
+            std::atomic<size_t>         ready { 0 } ;
+            std::vector<std::thread>    loaders ;
+            for (size_t t = 0 ; t < load ; ++t) {
+                loaders.emplace_back ([&running, &ready, hammer, t]() mutable {
+                    Bench::pin_to_cpu (t + 1) ;
+                    ready.fetch_add (1) ;
+                    uint64_t    sum = 0 ;
+                    while (running.load (std::memory_order_relaxed)) {
+                        sum += hammer () ;
+                    }
+                    Bench::do_not_optimize (sum) ;
+                }) ;
+            }
+            while (ready.load () < load) {
+                std::this_thread::yield () ;
+            }
+
+            Bench::histogram_t<>    H ;
+            const uint64_t  overhead = timer_overhead () ;
+            // Samples on a dedicated thread, so the caller's affinity stays untouched.
+            std::thread sampler { [&H, &fn, overhead, count]() {
+                Bench::pin_to_cpu (0) ;
+                for (size_t i = 0 ; i < count ; ++i) {
+                    const uint64_t  c0 = Bench::rdtsc () ;
+                    fn () ;
+                    const uint64_t  c1 = Bench::rdtsc () ;
+                    const uint64_t  d = c1 - c0 ;
+                    H.record (d < overhead ? 0 : d - overhead) ;
+                }
+            } } ;
+            sampler.join () ;
+            running.store (false) ;
+            for (auto &th : loaders) {
+                th.join () ;
+            }
+
+            const double    ratio = tsc_per_ns () ;
+            Bench::result_t result ;
+            result.group = "latency" ;
+            result.name = name ;
+            result.ops = count ;
+            result.repetitions = 1 ;
+            result.cycles = static_cast<double> (H.percentile (50)) ;
+            result.ns = result.cycles / ratio ;
+            result.min_cycles = static_cast<double> (H.percentile (0)) ;
+            result.add ("load", static_cast<double> (load))
+                  .add ("p50_ns", static_cast<double> (H.percentile (50)) / ratio)
+                  .add ("p99_ns", static_cast<double> (H.percentile (99)) / ratio)
+                  .add ("p999_ns", static_cast<double> (H.percentile (99.9)) / ratio)
+                  .add ("max_ns", static_cast<double> (H.max ()) / ratio) ;
+            return result ;
+        }
+
+    void    run_latency (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+        const size_t    N = Bench::scaled (opt, 200000) ;
+        const size_t    J = Bench::scaled (opt, 2000) ;
+        const size_t    L = opt.load < 0 ? Bench::max_threads (opt) - 1 : static_cast<size_t> (opt.load) ;
+
+        for (size_t load : { static_cast<size_t> (0), L }) {
+            shared_state_t  shared { { 0, 1 } } ;
+#if XOROSHIRO_LOCKFREE
+            reporter.add (sample ("next", N, load, hammer_shared { shared }, [&shared]() {
+                Bench::do_not_optimize (XoRoShiRo::next (shared.state)) ;
+            })) ;
+            reporter.add (sample ("jump", J, load, hammer_shared { shared }, [&shared]() {
+                Bench::do_not_optimize (XoRoShiRo::jump (shared.state)) ;
+            })) ;
+#endif
+#if CONTENTION_AVAILABLE
+            const Contention::backoff_t backoff ;
+            reporter.add (sample ("next+backoff", N, load, hammer_shared { shared }, [&shared, &backoff]() {
+                Bench::do_not_optimize (XoRoShiRo::next (shared.state, backoff)) ;
+            })) ;
+#endif
+            reporter.add (sample ("tls/unsafe_next", N, load, hammer_shared { shared }, []() {
+                Bench::do_not_optimize (XoRoShiRo::thread_next ()) ;
+            })) ;
+            {
+                // Every thread (sampler and load) shares the wait-free generator.
+                Engine::xoroshiro128_plus<Engine::threading::wait_free> wait_free { shared.state } ;
+                auto    hammer = [&wait_free]() -> uint64_t { return wait_free () ; } ;
+                reporter.add (sample ("wait_free/next", N, load, hammer, [&wait_free]() {
+                    Bench::do_not_optimize (wait_free ()) ;
+                })) ;
+            }
+            if (L == 0) {
+                break ;
+            }
+        }
+    }
+
+    Bench::registrar_t  latency { "latency", "Per-call latency percentiles of next/jump under background load (--load)"
+                                , run_latency } ;
+}
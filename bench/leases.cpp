@@ -0,0 +1,75 @@
+/*
+ * leases.cpp: Streams per second handed out by the lease service, by request pattern.
+ */
+#include "threads.hpp"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "lease_service.hpp"
+
+namespace {
+
+    void    run_leases (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+        const std::string   group { "lease" } ;
+        const std::string   path = "bench_lease_" + std::to_string (::getpid ()) + ".sock" ;
+        const size_t        N = Bench::scaled (opt, 2000) ;     // Streams per client.
+        const size_t        DEPTH = 32 ;
+        const uint32_t      BATCH = 64 ;
+
+        LeaseService::server    server { path, XoRoShiRo::seed_state (0) } ;
+        std::thread th { [&server]() { server.serve () ; } } ;
+
+        auto    add = [&reporter](Bench::result_t result) {
+            result.add ("leases_per_sec", result.ns <= 0 ? 0.0 : 1.0e9 / result.ns) ;
+            reporter.add (result) ;
+        } ;
+
+        for (size_t T : Bench::thread_counts (opt)) {
+            const size_t    ops = T * N ;
+            std::vector<std::unique_ptr<LeaseService::client>>  clients ;
+            for (size_t t = 0 ; t < T ; ++t) {
+                clients.emplace_back (new LeaseService::client { path }) ;
+            }
+            // A fresh connection per stream (worker startup).
+            add (Bench::measure_parallel (group, "connect+take", T, ops, opt, [&path, N](size_t) {
+                for (size_t i = 0 ; i < N ; ++i) {
+                    Bench::do_not_optimize (LeaseService::client { path }.take () [0]) ;
+                }
+            })) ;
+            add (Bench::measure_parallel (group, "round_trip", T, ops, opt, [&clients, N](size_t tid) {
+                auto &  C = *clients [tid] ;
+                for (size_t i = 0 ; i < N ; ++i) {
+                    Bench::do_not_optimize (C.take () [0]) ;
+                }
+            })) ;
+            add (Bench::measure_parallel (group, "pipelined/" + std::to_string (DEPTH), T, ops, opt, [&clients, N, DEPTH](size_t tid) {
+                auto &  C = *clients [tid] ;
+                for (size_t i = 0 ; i < N ; i += DEPTH) {
+                    const size_t    n = std::min (DEPTH, N - i) ;
+                    for (size_t k = 0 ; k < n ; ++k) {
+                        C.post (1) ;
+                    }
+                    for (size_t k = 0 ; k < n ; ++k) {
+                        Bench::do_not_optimize (C.wait () [0]) ;
+                    }
+                }
+            })) ;
+            add (Bench::measure_parallel (group, "batched/" + std::to_string (BATCH), T, ops, opt, [&clients, N, BATCH](size_t tid) {
+                auto &  C = *clients [tid] ;
+                for (size_t i = 0 ; i < N ; i += BATCH) {
+                    Bench::do_not_optimize (C.take (static_cast<uint32_t> (std::min<size_t> (BATCH, N - i))) [0]) ;
+                }
+            })) ;
+        }
+        server.stop () ;
+        th.join () ;
+    }
+
+    Bench::registrar_t  leases { "lease", "Stream lease service over a Unix domain socket (round trips, pipelining and batching)"
+                               , run_leases } ;
+}
@@ -0,0 +1,217 @@
+
+#include "bench.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace Bench {
+
+    std::vector<mode_t> &   modes () {
+        static std::vector<mode_t>  M ;
+        return M ;
+    }
+
+    namespace {
+        std::string quote (const std::string &s) {
+            std::string result { "\"" } ;
+            for (auto ch : s) {
+                if (ch == '"' || ch == '\\') {
+                    result += '\\' ;
+                }
+                result += ch ;
+            }
+            return result + "\"" ;
+        }
+    }
+
+    void    reporter_t::write (std::ostream &out) const {
+        switch (format_) {
+        case format_t::TEXT:
+            for (const auto &r : results_) {
+                out << std::left << std::setw (12) << r.group << ' '
+                    << std::setw (36) << r.name << std::right << std::fixed << std::setprecision (3)
+                    << std::setw (12) << r.cycles << " cyc/op "
+                    << std::setw (12) << r.ns << " ns/op"
+                    << " (min " << r.min_cycles << ", " << r.outliers << "/" << r.repetitions << " outliers)" ;
+                for (const auto &kv : r.extra) {
+                    out << ' ' << kv.first << '=' << kv.second ;
+                }
+                out << '\n' ;
+            }
+            if (! summaries_.empty ()) {
+                out << "\nSummary:\n" ;
+                for (const auto &s : summaries_) {
+                    out << std::left << std::setw (12) << s.group << ' ' << std::setw (36) << s.name << std::right ;
+                    for (const auto &kv : s.values) {
+                        out << ' ' << kv.first << '=' << kv.second ;
+                    }
+                    out << '\n' ;
+                }
+            }
+            break ;
+        case format_t::CSV:
+            out << "group,name,ops,repetitions,outliers,cycles_per_op,ns_per_op,min_cycles_per_op,extra\n" ;
+            for (const auto &r : results_) {
+                out << r.group << ',' << r.name << ',' << r.ops << ',' << r.repetitions << ',' << r.outliers << ','
+                    << std::setprecision (6) << r.cycles << ',' << r.ns << ',' << r.min_cycles << ',' ;
+                const char *    sep = "" ;
+                for (const auto &kv : r.extra) {
+                    out << sep << kv.first << '=' << kv.second ;
+                    sep = ";" ;
+                }
+                out << '\n' ;
+            }
+            if (! summaries_.empty ()) {
+                // A second table, after a blank line.
+                out << "\ngroup,name,summary\n" ;
+                for (const auto &s : summaries_) {
+                    out << s.group << ',' << s.name << ',' ;
+                    const char *    sep = "" ;
+                    for (const auto &kv : s.values) {
+                        out << sep << kv.first << '=' << kv.second ;
+                        sep = ";" ;
+                    }
+                    out << '\n' ;
+                }
+            }
+            break ;
+        case format_t::JSON:
+            out << "{ \"results\": [\n" ;
+            for (size_t i = 0 ; i < results_.size () ; ++i) {
+                const auto &    r = results_ [i] ;
+                out << "  { \"group\": " << quote (r.group)
+                    << ", \"name\": " << quote (r.name)
+                    << ", \"ops\": " << r.ops
+                    << ", \"repetitions\": " << r.repetitions
+                    << ", \"outliers\": " << r.outliers
+                    << std::setprecision (6)
+                    << ", \"cycles_per_op\": " << r.cycles
+                    << ", \"ns_per_op\": " << r.ns
+                    << ", \"min_cycles_per_op\": " << r.min_cycles ;
+                for (const auto &kv : r.extra) {
+                    out << ", " << quote (kv.first) << ": " << kv.second ;
+                }
+                out << " }" << (i + 1 < results_.size () ? ",\n" : "\n") ;
+            }
+            out << "], \"summary\": [\n" ;
+            for (size_t i = 0 ; i < summaries_.size () ; ++i) {
+                const auto &    s = summaries_ [i] ;
+                out << "  { \"group\": " << quote (s.group)
+                    << ", \"name\": " << quote (s.name)
+                    << std::setprecision (6) ;
+                for (const auto &kv : s.values) {
+                    out << ", " << quote (kv.first) << ": " << kv.second ;
+                }
+                out << " }" << (i + 1 < summaries_.size () ? ",\n" : "\n") ;
+            }
+            out << "] }\n" ;
+            break ;
+        }
+    }
+}
+
+namespace {
+    void    usage (const char *prog) {
+        std::cerr << "Usage: " << prog << " [options]\n"
+                  << "  --mode NAME      Runs only the named mode (repeatable, default: all)\n"
+                  << "  --format FMT     text, csv or json (default: text)\n"
+                  << "  --output FILE    Writes results to FILE instead of stdout\n"
+                  << "  --reps N         # of measured runs (default: 31)\n"
+                  << "  --warmup N       # of discarded runs (default: 3)\n"
+                  << "  --scale X        Scales # of operations per run (default: 1.0)\n"
+                  << "  --threads N      Max. # of threads for multi-threaded modes (default: all)\n"
+                  << "  --load N         # of background load threads for latency modes (default: all but one)\n"
+                  << "  --no-perf        Does not read hardware counters (perf_event)\n"
+                  << "  --list           Lists available modes\n" ;
+    }
+}
+
+int main (int argc, char **argv) {
+    Bench::options_t            opt ;
+    std::vector<std::string>    selected ;
+    std::string                 output ;
+
+    for (int i = 1 ; i < argc ; ++i) {
+        auto    arg = [&]() -> const char * {
+            if (argc <= i + 1) {
+                usage (argv [0]) ;
+                exit (1) ;
+            }
+            return argv [++i] ;
+        } ;
+        if (strcmp (argv [i], "--mode") == 0) {
+            selected.emplace_back (arg ()) ;
+        }
+        else if (strcmp (argv [i], "--format") == 0) {
+            std::string fmt { arg () } ;
+            if (fmt == "text") {
+                opt.format = Bench::format_t::TEXT ;
+            }
+            else if (fmt == "csv") {
+                opt.format = Bench::format_t::CSV ;
+            }
+            else if (fmt == "json") {
+                opt.format = Bench::format_t::JSON ;
+            }
+            else {
+                usage (argv [0]) ;
+                return 1 ;
+            }
+        }
+        else if (strcmp (argv [i], "--output") == 0) {
+            output = arg () ;
+        }
+        else if (strcmp (argv [i], "--reps") == 0) {
+            opt.repetitions = std::max<size_t> (1, strtoul (arg (), nullptr, 0)) ;
+        }
+        else if (strcmp (argv [i], "--warmup") == 0) {
+            opt.warmup = strtoul (arg (), nullptr, 0) ;
+        }
+        else if (strcmp (argv [i], "--scale") == 0) {
+            opt.scale = strtod (arg (), nullptr) ;
+        }
+        else if (strcmp (argv [i], "--threads") == 0) {
+            opt.threads = strtoul (arg (), nullptr, 0) ;
+        }
+        else if (strcmp (argv [i], "--load") == 0) {
+            opt.load = atoi (arg ()) ;
+        }
+        else if (strcmp (argv [i], "--no-perf") == 0) {
+            opt.perf = false ;
+        }
+        else if (strcmp (argv [i], "--list") == 0) {
+            for (const auto &m : Bench::modes ()) {
+                std::cout << std::left << std::setw (16) << m.name << m.description << '\n' ;
+            }
+            return 0 ;
+        }
+        else {
+            usage (argv [0]) ;
+            return 1 ;
+        }
+    }
+
+    Bench::reporter_t   reporter { opt.format } ;
+    for (const auto &m : Bench::modes ()) {
+        if (selected.empty () || std::find (selected.begin (), selected.end (), m.name) != selected.end ()) {
+            m.run (opt, reporter) ;
+        }
+    }
+
+    if (output.empty ()) {
+        reporter.write (std::cout) ;
+    }
+    else {
+        std::ofstream   out { output } ;
+        if (! out) {
+            std::cerr << "Failed to open " << output << '\n' ;
+            return 1 ;
+        }
+        reporter.write (out) ;
+    }
+    return 0 ;
+}
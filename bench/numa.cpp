@@ -0,0 +1,66 @@
+/*
+ * numa.cpp: Per-thread generators whose state and output buffer are local vs. remote to the thread.
+ */
+#include "threads.hpp"
+
+#include <memory>
+
+#include "numa_bank.hpp"
+#include "xoroshiro.hpp"
+
+namespace {
+
+    void    run_numa (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+        const std::string   group { "numa" } ;
+        const size_t        N = Bench::scaled (opt, 200000) ;  // Per thread.
+        const size_t        WORDS = 4096 ;                      // Output buffer of a thread.
+
+        struct variant_t {
+            const char *        name ;
+            Numa::placement_t   placement ;
+            bool                by_owner ;  // false: The main thread places every shard.
+        } ;
+        const variant_t variants [] = { { "bank/main_thread", Numa::placement_t::first_touch, false }
+                                      , { "bank/first_touch", Numa::placement_t::first_touch, true }
+                                      , { "bank/bind", Numa::placement_t::bind, true } } ;
+
+        for (size_t T : Bench::thread_counts (opt)) {
+            const size_t    ops = T * N ;
+            for (const auto &v : variants) {
+                std::unique_ptr<Numa::shard_bank>   bank { new Numa::shard_bank { T, WORDS, v.placement } } ;
+                if (v.by_owner) {
+                    // Same pinning as the measured threads.
+                    Bench::run_parallel (T, [&bank](size_t tid) {
+                        bank->place (tid, XoRoShiRo::state_t { tid, 1 }) ;
+                    }) ;
+                }
+                else {
+                    for (size_t t = 0 ; t < T ; ++t) {
+                        bank->place (t, XoRoShiRo::state_t { t, 1 }) ;
+                    }
+                }
+                auto    result = Bench::measure_parallel (group, v.name, T, ops, opt, [&bank, N, WORDS](size_t tid) {
+                    auto &      S = bank->state (tid) ;
+                    uint64_t *  out = bank->buffer (tid) ;
+                    for (size_t i = 0 ; i < N ; i += WORDS) {
+                        XoRoShiRo::unsafe_fill (S, out, std::min (WORDS, N - i)) ;
+                        Bench::do_not_optimize (out [0]) ;
+                    }
+                }) ;
+                // Placement: Shards on the node of the CPU their thread is pinned to.
+                size_t  local = 0 ;
+                for (size_t t = 0 ; t < T ; ++t) {
+                    const size_t    cpu = t % std::max<size_t> (1, std::thread::hardware_concurrency ()) ;
+                    local += bank->node_of (t) == Numa::node_of_cpu (cpu) ? 1 : 0 ;
+                }
+                result.add ("nodes", static_cast<double> (Numa::node_count ())) ;
+                result.add ("local_shards", static_cast<double> (local) / static_cast<double> (T)) ;
+                result.add ("numa_policies", Numa::available () ? 1.0 : 0.0) ;
+                reporter.add (result) ;
+            }
+        }
+    }
+
+    Bench::registrar_t  numa { "numa", "Per-thread generator banks placed by the main thread, by first touch and by mbind"
+                             , run_numa } ;
+}
@@ -0,0 +1,56 @@
+/*
+ * percpu.cpp: rseq per-CPU generator vs. the lock-free `next` on a shared state.
+ */
+#include "threads.hpp"
+
+#include <memory>
+
+#include "xoroshiro.hpp"
+#include "xoroshiro_percpu.hpp"
+
+namespace {
+
+#if XOROSHIRO_LOCKFREE
+    struct alignas (XORSHIFT_CACHE_LINE_SIZE) padded_state_t {
+        XoRoShiRo::state_t  state ;
+    } ;
+
+    void    run_percpu (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+        const std::string   group { "percpu" } ;
+        const size_t        N = Bench::scaled (opt, 200000) ;  // Per thread.
+        const XoRoShiRo::state_t    root { 0, 1 } ;
+
+        for (size_t T : Bench::thread_counts (opt)) {
+            const size_t    ops = T * N ;
+            {
+                padded_state_t  shared { root } ;
+                reporter.add (Bench::measure_parallel (group, "shared/next", T, ops, opt, [&shared, N](size_t) {
+                    uint64_t    sum = 0 ;
+                    for (size_t i = 0 ; i < N ; ++i) {
+                        sum += XoRoShiRo::next (shared.state) ;
+                    }
+                    Bench::do_not_optimize (sum) ;
+                })) ;
+            }
+            for (bool use_rseq : { true, false }) {
+                std::unique_ptr<XoRoShiRo::percpu_generator>    gen { new XoRoShiRo::percpu_generator { root, use_rseq } } ;
+                if (use_rseq && ! gen->uses_rseq ()) {
+                    continue ;  // Would measure the fallback twice.
+                }
+                auto    result = Bench::measure_parallel (group, use_rseq ? "percpu/rseq" : "percpu/sched_getcpu+cas", T, ops, opt, [&gen, N](size_t) {
+                    uint64_t    sum = 0 ;
+                    for (size_t i = 0 ; i < N ; ++i) {
+                        sum += gen->next () ;
+                    }
+                    Bench::do_not_optimize (sum) ;
+                }) ;
+                result.add ("streams", static_cast<double> (gen->streams ())) ;
+                reporter.add (result) ;
+            }
+        }
+    }
+
+    Bench::registrar_t  percpu { "percpu", "rseq per-CPU generator (and its sched_getcpu + CAS fallback) vs. the shared lock-free next"
+                               , run_percpu } ;
+#endif
+}
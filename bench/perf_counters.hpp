@@ -0,0 +1,147 @@
+/**
+ * perf_counters.hpp: Hardware performance counters around measured regions (Linux perf_event).
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef perf_counters_hpp__7E3B1D95_2C64_4A0F_B8E1_4F6A9C2D0B83
+#define perf_counters_hpp__7E3B1D95_2C64_4A0F_B8E1_4F6A9C2D0B83  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <array>
+
+#if defined (__linux__)
+#   include <linux/perf_event.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+namespace Bench {
+
+    /**
+     * A set of per-thread hardware counters, opened as one perf_event group.
+     * The kernel schedules a group as a whole, so every counter covers the same window even when
+     * the PMU is multiplexed (IPC and the per-op ratios stay consistent).
+     * Counters the host does not support (VMs, `perf_event_paranoid`, non-Linux...) are silently
+     * left out, so `available` may return false for some or all of them.
+     */
+    class perf_counters_t {
+    public:
+        enum counter_t { CYCLES, INSTRUCTIONS, L1D_MISSES, BRANCH_MISSES, NUM_COUNTERS } ;
+
+        using values_t = std::array<uint64_t, NUM_COUNTERS> ;
+
+        static const char * name_of (counter_t c) {
+            static const char * names [] = { "hw_cycles", "instructions", "l1d_misses", "branch_misses" } ;
+            return names [c] ;
+        }
+    private:
+        std::array<int, NUM_COUNTERS>   fds_ ;
+        std::array<int, NUM_COUNTERS>   slots_ ;    // Position of each counter in a group read (-1: not opened).
+        int     leader_ = -1 ;
+        int     members_ = 0 ;
+    public:
+        perf_counters_t () {
+            fds_.fill (-1) ;
+            slots_.fill (-1) ;
+#if defined (__linux__)
+            auto    open = [this](counter_t c, uint32_t type, uint64_t config) {
+                struct perf_event_attr  attr ;
+                memset (&attr, 0, sizeof (attr)) ;
+                attr.size = sizeof (attr) ;
+                attr.type = type ;
+                attr.config = config ;
+                attr.disabled = leader_ < 0 ? 1 : 0 ;   // Members follow the leader.
+                attr.exclude_kernel = 1 ;
+                attr.exclude_hv = 1 ;
+                attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING ;
+                const int   fd = static_cast<int> (syscall (__NR_perf_event_open, &attr, 0, -1, leader_, 0)) ;
+                if (fd < 0) {
+                    return ;
+                }
+                if (leader_ < 0) {
+                    leader_ = fd ;
+                }
+                fds_ [c] = fd ;
+                slots_ [c] = members_++ ;
+            } ;
+            open (CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES) ;
+            open (INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS) ;
+            open (L1D_MISSES, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                                                | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)) ;
+            open (BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES) ;
+#endif
+        }
+
+        perf_counters_t (const perf_counters_t &) = delete ;
+        perf_counters_t &   operator = (const perf_counters_t &) = delete ;
+
+        ~perf_counters_t () {
+#if defined (__linux__)
+            // Members first, the leader last.
+            for (size_t i = NUM_COUNTERS ; 0 < i-- ; ) {
+                if (0 <= fds_ [i]) {
+                    close (fds_ [i]) ;
+                }
+            }
+#endif
+        }
+
+        bool    available (counter_t c) const {
+            return 0 <= fds_ [c] ;
+        }
+
+        bool    any_available () const {
+            return 0 <= leader_ ;
+        }
+
+        void    start () {
+#if defined (__linux__)
+            if (0 <= leader_) {
+                ioctl (leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP) ;
+                ioctl (leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) ;
+            }
+#endif
+        }
+
+        /// Stops counting and returns the counts since `start` (scaled when the kernel multiplexed the group).
+        values_t    stop () {
+            values_t    result ;
+            result.fill (0) ;
+#if defined (__linux__)
+            if (leader_ < 0) {
+                return result ;
+            }
+            ioctl (leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP) ;
+            uint64_t    buf [3 + NUM_COUNTERS] ;    // nr, time_enabled, time_running, values...
+            const ssize_t   size = static_cast<ssize_t> ((3 + members_) * sizeof (uint64_t)) ;
+            if (read (leader_, buf, sizeof (buf)) != size || buf [0] != static_cast<uint64_t> (members_)) {
+                return result ;
+            }
+            for (size_t i = 0 ; i < NUM_COUNTERS ; ++i) {
+                if (slots_ [i] < 0) {
+                    continue ;
+                }
+                const uint64_t  v = buf [3 + slots_ [i]] ;
+                result [i] = (buf [2] == 0 || buf [2] == buf [1])
+                           ? v
+                           : static_cast<uint64_t> (static_cast<double> (v) * static_cast<double> (buf [1]) / static_cast<double> (buf [2])) ;
+            }
+#endif
+            return result ;
+        }
+
+        /// Counters of the calling thread (opened at the first use).
+        static perf_counters_t &    thread_instance () {
+            thread_local perf_counters_t    counters ;
+            return counters ;
+        }
+    } ;
+}
+
+#endif /* perf_counters_hpp__7E3B1D95_2C64_4A0F_B8E1_4F6A9C2D0B83 */
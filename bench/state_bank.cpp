@@ -0,0 +1,68 @@
+/*
+ * state_bank.cpp: Stepping many streams at once, array-of-states vs. the structure-of-arrays bank.
+ */
+#include "bench.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "state_bank.hpp"
+#include "xoroshiro.hpp"
+
+namespace {
+
+    void    run_state_bank (const Bench::options_t &opt, Bench::reporter_t &reporter) {
+        const std::string   group { "bank" } ;
+        const size_t        N = Bench::scaled (opt, 1u << 20) ;    // # of streams.
+        const XoRoShiRo::state_t    root = XoRoShiRo::seed_state (42) ;
+
+        XoRoShiRo::state_bank   bank { N, root } ;
+        std::vector<XoRoShiRo::state_t> states (N) ;
+        for (size_t i = 0 ; i < N ; ++i) {
+            states [i] = bank.get (i) ;
+        }
+        std::vector<uint64_t>   out (N) ;
+
+        auto    add = [&reporter](Bench::result_t result) {
+            result.add ("avx2", XOROSHIRO_BANK_AVX2 ? 1.0 : 0.0) ;
+            reporter.add (result) ;
+        } ;
+
+        add (Bench::measure (group, "aos/unsafe_next", N, opt, [&states, &out]() {
+            for (size_t i = 0 ; i < states.size () ; ++i) {
+                out [i] = XoRoShiRo::unsafe_next (states [i]) ;
+            }
+            Bench::do_not_optimize (out [0]) ;
+        })) ;
+        add (Bench::measure (group, "soa/next_all", N, opt, [&bank, &out]() {
+            bank.next_all (out.data ()) ;
+            Bench::do_not_optimize (out [0]) ;
+        })) ;
+        add (Bench::measure (group, "soa/advance_all", N, opt, [&bank]() {
+            bank.advance_all () ;
+            Bench::do_not_optimize (bank.s0 () [0]) ;
+        })) ;
+
+        // A random quarter of the streams, in increasing order.
+        std::vector<XoRoShiRo::state_bank::index_t> indices (N) ;
+        std::iota (indices.begin (), indices.end (), 0) ;
+        std::shuffle (indices.begin (), indices.end (), std::mt19937_64 { 42 }) ;
+        indices.resize (std::max<size_t> (1, N / 4)) ;
+        std::sort (indices.begin (), indices.end ()) ;
+        add (Bench::measure (group, "aos/unsafe_next/quarter", indices.size (), opt, [&states, &indices, &out]() {
+            for (size_t k = 0 ; k < indices.size () ; ++k) {
+                out [k] = XoRoShiRo::unsafe_next (states [indices [k]]) ;
+            }
+            Bench::do_not_optimize (out [0]) ;
+        })) ;
+        add (Bench::measure (group, "soa/next_masked/quarter", indices.size (), opt, [&bank, &indices, &out]() {
+            bank.next_masked (indices.data (), indices.size (), out.data ()) ;
+            Bench::do_not_optimize (out [0]) ;
+        })) ;
+    }
+
+    Bench::registrar_t  state_bank { "bank", "Per-agent streams: array of states vs. the structure-of-arrays state bank"
+                                   , run_state_bank } ;
+}
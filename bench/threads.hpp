@@ -0,0 +1,106 @@
+/**
+ * threads.hpp: Helpers for multi-threaded benchmark modes (pinning, synchronized start).
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef threads_hpp__5C0E9B3D_7A41_4E8F_92D6_0B8F3A6E1C27
+#define threads_hpp__5C0E9B3D_7A41_4E8F_92D6_0B8F3A6E1C27  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#if defined (__linux__)
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+#include "bench.hpp"
+
+namespace Bench {
+
+    /// # of hardware threads available for the multi-threaded modes.
+    inline size_t   max_threads (const options_t &opt) {
+        const size_t    hw = std::max<size_t> (1, std::thread::hardware_concurrency ()) ;
+        return opt.threads == 0 ? hw : opt.threads ;
+    }
+
+    /// 1, 2, 4, ... up to `max_threads (opt)` (the maximum itself is always included).
+    inline std::vector<size_t>  thread_counts (const options_t &opt) {
+        std::vector<size_t> result ;
+        const size_t    N = max_threads (opt) ;
+        for (size_t n = 1 ; n < N ; n *= 2) {
+            result.push_back (n) ;
+        }
+        result.push_back (N) ;
+        return result ;
+    }
+
+    /// Pins the calling thread to the `idx`-th CPU (modulo # of CPUs, no-op where unsupported).
+    inline void pin_to_cpu (size_t idx) {
+#if defined (__linux__)
+        cpu_set_t   cpus ;
+        CPU_ZERO (&cpus) ;
+        CPU_SET (static_cast<int> (idx % std::max<size_t> (1, std::thread::hardware_concurrency ())), &cpus) ;
+        pthread_setaffinity_np (pthread_self (), sizeof (cpus), &cpus) ;
+#else
+        (void)idx ;
+#endif
+    }
+
+    /**
+     * Runs `fn (tid)` on `num_threads` pinned threads released at once.
+     * @return Wall clock of the slowest thread.
+     */
+    template <typename F_>
+        sample_t    run_parallel (size_t num_threads, F_ &&fn) {
+            std::atomic<size_t> ready { 0 } ;
+            std::atomic<bool>   go { false } ;
+            std::vector<std::thread>    threads ;
+            for (size_t t = 0 ; t < num_threads ; ++t) {
+                threads.emplace_back ([&, t]() {
+                    pin_to_cpu (t) ;
+                    ready.fetch_add (1) ;
+                    while (! go.load (std::memory_order_acquire)) {
+                        /* spin */
+                    }
+                    fn (t) ;
+                }) ;
+            }
+            while (ready.load () < num_threads) {
+                std::this_thread::yield () ;
+            }
+            const auto      t0 = std::chrono::steady_clock::now () ;
+            const uint64_t  c0 = rdtsc () ;
+            go.store (true, std::memory_order_release) ;
+            for (auto &th : threads) {
+                th.join () ;
+            }
+            const uint64_t  c1 = rdtsc () ;
+            const auto      t1 = std::chrono::steady_clock::now () ;
+            return sample_t { c1 - c0, static_cast<uint64_t> (std::chrono::duration_cast<std::chrono::nanoseconds> (t1 - t0).count ()) } ;
+        }
+
+    /// Multi-threaded counterpart of `measure` (`ops` counts operations of all threads).
+    template <typename F_>
+        result_t    measure_parallel (const std::string &group, const std::string &name, size_t num_threads, size_t ops, const options_t &opt, F_ &&fn) {
+            for (size_t i = 0 ; i < opt.warmup ; ++i) {
+                run_parallel (num_threads, fn) ;
+            }
+            std::vector<sample_t>   samples ;
+            for (size_t i = 0 ; i < opt.repetitions ; ++i) {
+                samples.push_back (run_parallel (num_threads, fn)) ;
+            }
+            auto    result = summarize (group, name, ops, samples) ;
+            result.add ("threads", static_cast<double> (num_threads)) ;
+            result.add ("mops_per_sec", result.ns <= 0 ? 0.0 : 1.0e3 / result.ns) ;
+            return result ;
+        }
+}
+
+#endif /* threads_hpp__5C0E9B3D_7A41_4E8F_92D6_0B8F3A6E1C27 */
@@ -0,0 +1,181 @@
+/**
+ * block_dispenser.hpp: Multi-producer/multi-consumer dispenser of xoroshiro128+ random blocks.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef block_dispenser_hpp__E3D8E2A4_51B1_4F23_9F3B_6C1A0C6E0D52
+#define block_dispenser_hpp__E3D8E2A4_51B1_4F23_9F3B_6C1A0C6E0D52  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "xoroshiro.hpp"
+
+#ifndef XORSHIFT_CACHE_LINE_SIZE
+#   define XORSHIFT_CACHE_LINE_SIZE    64
+#endif
+
+namespace XoRoShiRo {
+
+    /**
+     * Bounded lock-free queue of pre-filled random blocks.
+     *
+     * Any number of producers fill free slots from their own `state_t`, any number of consumers
+     * take whole blocks.  Both sides claim a slot with a single CAS on the queue position
+     * (instead of one CAS per value as `next` does).
+     *
+     * @tparam BLOCK_SIZE_ # of `uint64_t` in a block (default: 4KiB).
+     * @tparam NUM_BLOCKS_ # of slots in the queue (should be a power of 2).
+     */
+    template <size_t BLOCK_SIZE_ = 512, size_t NUM_BLOCKS_ = 64>
+        class block_dispenser {
+            static_assert (0 < BLOCK_SIZE_, "Block should not be empty.") ;
+            static_assert (1 < NUM_BLOCKS_ && (NUM_BLOCKS_ & (NUM_BLOCKS_ - 1)) == 0, "# of blocks should be a power of 2.") ;
+        public:
+            static constexpr size_t BLOCK_SIZE = BLOCK_SIZE_ ;
+            static constexpr size_t NUM_BLOCKS = NUM_BLOCKS_ ;
+        private:
+            static constexpr size_t MASK = NUM_BLOCKS_ - 1 ;
+            static constexpr size_t STRIDE = (BLOCK_SIZE_ * sizeof (uint64_t) + XORSHIFT_CACHE_LINE_SIZE - 1) / XORSHIFT_CACHE_LINE_SIZE * XORSHIFT_CACHE_LINE_SIZE ;
+
+            struct alignas (XORSHIFT_CACHE_LINE_SIZE) sequence_t {
+                std::atomic<size_t> value ;
+            } ;
+
+            alignas (XORSHIFT_CACHE_LINE_SIZE) std::atomic<size_t>   enqueue_pos_ { 0 } ;
+            alignas (XORSHIFT_CACHE_LINE_SIZE) std::atomic<size_t>   dequeue_pos_ { 0 } ;
+            alignas (XORSHIFT_CACHE_LINE_SIZE) std::unique_ptr<sequence_t []>    sequences_ ;
+            std::unique_ptr<uint8_t []> storage_ ;
+            uint8_t *                   blocks_ ;
+            std::atomic<bool>           running_ { false } ;
+            std::vector<std::thread>    producers_ ;
+        public:
+            block_dispenser ()
+                    : sequences_ (new sequence_t [NUM_BLOCKS_])
+                    , storage_ (new uint8_t [STRIDE * NUM_BLOCKS_ + XORSHIFT_CACHE_LINE_SIZE]) {
+                for (size_t i = 0 ; i < NUM_BLOCKS_ ; ++i) {
+                    sequences_ [i].value.store (i, std::memory_order_relaxed) ;
+                }
+                auto p = reinterpret_cast<uintptr_t> (storage_.get ()) ;
+                p = (p + XORSHIFT_CACHE_LINE_SIZE - 1) & ~static_cast<uintptr_t> (XORSHIFT_CACHE_LINE_SIZE - 1) ;
+                blocks_ = reinterpret_cast<uint8_t *> (p) ;
+            }
+
+            block_dispenser (const block_dispenser &) = delete ;
+            block_dispenser &   operator = (const block_dispenser &) = delete ;
+
+            ~block_dispenser () {
+                stop () ;
+            }
+
+            /**
+             * Launches `num_producers` background producers.
+             * The i-th producer draws from `root` jumped i times, so their streams never overlap.
+             */
+            void    start (const state_t &root, size_t num_producers, std::chrono::microseconds idle = std::chrono::microseconds { 50 }) {
+                if (running_.exchange (true)) {
+                    return ;
+                }
+                state_t S = root ;
+                for (size_t i = 0 ; i < num_producers ; ++i) {
+                    producers_.emplace_back ([this, S, idle]() {
+                        state_t state = S ;
+                        while (running_.load (std::memory_order_relaxed)) {
+                            if (! produce (state)) {
+                                std::this_thread::sleep_for (idle) ;
+                            }
+                        }
+                    }) ;
+                    unsafe_jump (S) ;
+                }
+            }
+
+            /// Stops background producers (blocks already produced stay available).
+            void    stop () {
+                if (running_.exchange (false)) {
+                    for (auto &th : producers_) {
+                        th.join () ;
+                    }
+                    producers_.clear () ;
+                }
+            }
+
+            /**
+             * Fills one free slot from `state` (producer side).
+             * @return false if the queue was full.
+             */
+            bool    produce (state_t &state) {
+                size_t  pos = enqueue_pos_.load (std::memory_order_relaxed) ;
+                while (true) {
+                    const size_t    seq = sequences_ [pos & MASK].value.load (std::memory_order_acquire) ;
+                    const intptr_t  diff = static_cast<intptr_t> (seq) - static_cast<intptr_t> (pos) ;
+                    if (diff == 0) {
+                        if (enqueue_pos_.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed)) {
+                            break ;
+                        }
+                    }
+                    else if (diff < 0) {
+                        return false ;
+                    }
+                    else {
+                        pos = enqueue_pos_.load (std::memory_order_relaxed) ;
+                    }
+                }
+                unsafe_fill (state, block_at (pos), BLOCK_SIZE_) ;
+                sequences_ [pos & MASK].value.store (pos + 1, std::memory_order_release) ;
+                return true ;
+            }
+
+            /**
+             * Takes one ready block and passes it to `fn` (consumer side, zero copy).
+             * The slot is handed back to the producers when `fn` returns.
+             * @return false if no block was ready.
+             */
+            template <typename F_>
+                bool    consume_in_place (F_ &&fn) {
+                    size_t  pos = dequeue_pos_.load (std::memory_order_relaxed) ;
+                    while (true) {
+                        const size_t    seq = sequences_ [pos & MASK].value.load (std::memory_order_acquire) ;
+                        const intptr_t  diff = static_cast<intptr_t> (seq) - static_cast<intptr_t> (pos + 1) ;
+                        if (diff == 0) {
+                            if (dequeue_pos_.compare_exchange_weak (pos, pos + 1, std::memory_order_relaxed)) {
+                                break ;
+                            }
+                        }
+                        else if (diff < 0) {
+                            return false ;
+                        }
+                        else {
+                            pos = dequeue_pos_.load (std::memory_order_relaxed) ;
+                        }
+                    }
+                    fn (static_cast<const uint64_t *> (block_at (pos))) ;
+                    sequences_ [pos & MASK].value.store (pos + NUM_BLOCKS_, std::memory_order_release) ;
+                    return true ;
+                }
+
+            /**
+             * Copies one ready block into `out` (consumer side).
+             * @return false if no block was ready.
+             */
+            bool    consume (uint64_t *out) {
+                return consume_in_place ([out](const uint64_t *blk) {
+                    ::memcpy (out, blk, BLOCK_SIZE_ * sizeof (uint64_t)) ;
+                }) ;
+            }
+        private:
+            uint64_t *  block_at (size_t idx) const {
+                return reinterpret_cast<uint64_t *> (blocks_ + STRIDE * (idx & MASK)) ;
+            }
+        } ;
+}
+
+#endif /* block_dispenser_hpp__E3D8E2A4_51B1_4F23_9F3B_6C1A0C6E0D52 */
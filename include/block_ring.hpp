@@ -0,0 +1,157 @@
+/**
+ * block_ring.hpp: Background producer of xoroshiro128+ random blocks (single-producer/single-consumer).
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef block_ring_hpp__3AE66C87_7F82_4D86_A14F_471B8F60F44D
+#define block_ring_hpp__3AE66C87_7F82_4D86_A14F_471B8F60F44D  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "xoroshiro.hpp"
+
+#ifndef XORSHIFT_CACHE_LINE_SIZE
+#   define XORSHIFT_CACHE_LINE_SIZE    64
+#endif
+
+namespace XoRoShiRo {
+
+    /**
+     * Ring of pre-filled random blocks.
+     *
+     * One producer (either the background thread launched by `start` or a caller of `produce`)
+     * fills blocks from its own `state_t`, one consumer takes them with `acquire`/`release`.
+     * Consumer side operations are wait-free.
+     *
+     * The default geometry (32 blocks of 4KiB) keeps the whole ring within 128KiB, so it stays in L2.
+     *
+     * @tparam BLOCK_SIZE_ # of `uint64_t` in a block.
+     * @tparam NUM_BLOCKS_ # of blocks in the ring (should be a power of 2).
+     */
+    template <size_t BLOCK_SIZE_ = 512, size_t NUM_BLOCKS_ = 32>
+        class block_ring {
+            static_assert (0 < BLOCK_SIZE_, "Block should not be empty.") ;
+            static_assert (1 < NUM_BLOCKS_ && (NUM_BLOCKS_ & (NUM_BLOCKS_ - 1)) == 0, "# of blocks should be a power of 2.") ;
+        public:
+            static constexpr size_t BLOCK_SIZE = BLOCK_SIZE_ ;
+            static constexpr size_t NUM_BLOCKS = NUM_BLOCKS_ ;
+
+            /// Called on the consumer thread with the # of ready blocks when it dropped below the watermark.
+            using callback_t = std::function<void (size_t)> ;
+        private:
+            static constexpr size_t MASK = NUM_BLOCKS_ - 1 ;
+            static constexpr size_t STRIDE = (BLOCK_SIZE_ * sizeof (uint64_t) + XORSHIFT_CACHE_LINE_SIZE - 1) / XORSHIFT_CACHE_LINE_SIZE * XORSHIFT_CACHE_LINE_SIZE ;
+
+            alignas (XORSHIFT_CACHE_LINE_SIZE) std::atomic<size_t>   head_ { 0 } ;   // Written by the consumer.
+            alignas (XORSHIFT_CACHE_LINE_SIZE) std::atomic<size_t>   tail_ { 0 } ;   // Written by the producer.
+            alignas (XORSHIFT_CACHE_LINE_SIZE) state_t  state_ ;
+            std::unique_ptr<uint8_t []> storage_ ;
+            uint8_t *                   blocks_ ;
+            size_t                      low_watermark_ ;
+            callback_t                  on_low_ ;
+            bool                        below_ = false ;
+            std::atomic<bool>           running_ { false } ;
+            std::thread                 producer_ ;
+        public:
+            explicit block_ring (const state_t &state, size_t low_watermark = NUM_BLOCKS_ / 4, callback_t on_low = callback_t {})
+                    : state_ (state)
+                    , storage_ (new uint8_t [STRIDE * NUM_BLOCKS_ + XORSHIFT_CACHE_LINE_SIZE])
+                    , low_watermark_ (low_watermark)
+                    , on_low_ (std::move (on_low)) {
+                auto p = reinterpret_cast<uintptr_t> (storage_.get ()) ;
+                p = (p + XORSHIFT_CACHE_LINE_SIZE - 1) & ~static_cast<uintptr_t> (XORSHIFT_CACHE_LINE_SIZE - 1) ;
+                blocks_ = reinterpret_cast<uint8_t *> (p) ;
+            }
+
+            block_ring (const block_ring &) = delete ;
+            block_ring &    operator = (const block_ring &) = delete ;
+
+            ~block_ring () {
+                stop () ;
+            }
+
+            /// Launches the background producer.
+            void    start (std::chrono::microseconds idle = std::chrono::microseconds { 50 }) {
+                if (running_.exchange (true)) {
+                    return ;
+                }
+                producer_ = std::thread { [this, idle]() {
+                    while (running_.load (std::memory_order_relaxed)) {
+                        if (! produce ()) {
+                            std::this_thread::sleep_for (idle) ;
+                        }
+                    }
+                } } ;
+            }
+
+            /// Stops the background producer (blocks already produced stay available).
+            void    stop () {
+                if (running_.exchange (false)) {
+                    producer_.join () ;
+                }
+            }
+
+            /**
+             * Fills one free block (producer side).
+             * @return false if the ring was full.
+             */
+            bool    produce () {
+                const size_t t = tail_.load (std::memory_order_relaxed) ;
+                if (NUM_BLOCKS_ <= t - head_.load (std::memory_order_acquire)) {
+                    return false ;
+                }
+                unsafe_fill (state_, block_at (t), BLOCK_SIZE_) ;
+                tail_.store (t + 1, std::memory_order_release) ;
+                return true ;
+            }
+
+            /**
+             * Takes the oldest ready block (consumer side, wait-free).
+             * @return nullptr if no block was ready.
+             */
+            const uint64_t *    acquire () {
+                const size_t h = head_.load (std::memory_order_relaxed) ;
+                const size_t ready = tail_.load (std::memory_order_acquire) - h ;
+                if (ready < low_watermark_) {
+                    if (! below_ && on_low_) {
+                        on_low_ (ready) ;
+                    }
+                    below_ = true ;
+                }
+                else {
+                    below_ = false ;
+                }
+                if (ready == 0) {
+                    return nullptr ;
+                }
+                return block_at (h) ;
+            }
+
+            /// Hands the block obtained by the last `acquire` back to the producer.
+            void    release () {
+                const size_t h = head_.load (std::memory_order_relaxed) ;
+                assert (h != tail_.load (std::memory_order_acquire)) ;
+                head_.store (h + 1, std::memory_order_release) ;
+            }
+
+            /// # of blocks ready to be consumed.
+            size_t  ready () const {
+                return tail_.load (std::memory_order_acquire) - head_.load (std::memory_order_acquire) ;
+            }
+        private:
+            uint64_t *  block_at (size_t idx) const {
+                return reinterpret_cast<uint64_t *> (blocks_ + STRIDE * (idx & MASK)) ;
+            }
+        } ;
+}
+
+#endif /* block_ring_hpp__3AE66C87_7F82_4D86_A14F_471B8F60F44D */
@@ -0,0 +1,343 @@
+/**
+ * checkpoint.hpp: Versioned binary snapshots of generator states, loaded zero-copy with `mmap` (POSIX).
+ *
+ * Layout (all integers little-endian):
+ *
+ *      offset  size
+ *           0     8    magic "XSSTATE\x1A"
+ *           8     4    version (1)
+ *          12     4    generator kind (`kind_t`)
+ *          16     8    # of states
+ *          24     8    checksum of the states
+ *          32    32    reserved (0)
+ *          64  16*N    states: s[0], s[1] of each
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef checkpoint_hpp__A0E5C3B9_64D2_4F18_9B7A_1D8E2F6C4053
+#define checkpoint_hpp__A0E5C3B9_64D2_4F18_9B7A_1D8E2F6C4053  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <array>
+#include <new>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "xorshift.hpp"
+#include "xoroshiro.hpp"
+
+namespace Checkpoint {
+
+    static_assert (std::is_same<XorShift::state_t, XoRoShiRo::state_t>::value, "Both generators should share the state type.") ;
+    static_assert (sizeof (XoRoShiRo::state_t) == 2 * sizeof (uint64_t), "state_t should be 16 bytes.") ;
+
+    using state_t = XoRoShiRo::state_t ;
+
+    /// Generator the states belong to (a snapshot only loads as the kind it was saved as).
+    enum class kind_t : uint32_t {
+        xorshift128_plus = 1,
+        xoroshiro128_plus = 2,
+    } ;
+
+    const uint32_t  VERSION = 1 ;
+    const size_t    HEADER_SIZE = 64 ;
+
+    namespace detail {
+        const uint8_t   MAGIC [8] = { 'X', 'S', 'S', 'T', 'A', 'T', 'E', 0x1A } ;
+
+        inline uint64_t rotl (uint64_t x, unsigned k) {
+            return (x << k) | (x >> (64 - k)) ;
+        }
+
+        inline uint64_t bswap (uint64_t x) {
+#if defined (__GNUC__)
+            return __builtin_bswap64 (x) ;
+#else
+            x = ((x & 0x00FF00FF00FF00FFull) << 8) | ((x >> 8) & 0x00FF00FF00FF00FFull) ;
+            x = ((x & 0x0000FFFF0000FFFFull) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFull) ;
+            return (x << 32) | (x >> 32) ;
+#endif
+        }
+
+        constexpr bool  big_endian () {
+#if defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            return true ;
+#else
+            return false ;
+#endif
+        }
+
+        inline void store_le (uint8_t *p, uint64_t v, size_t n) {
+            for (size_t i = 0 ; i < n ; ++i) {
+                p [i] = static_cast<uint8_t> (v >> (8 * i)) ;
+            }
+        }
+
+        inline uint64_t load_le (const uint8_t *p, size_t n) {
+            uint64_t    v = 0 ;
+            for (size_t i = 0 ; i < n ; ++i) {
+                v |= static_cast<uint64_t> (p [i]) << (8 * i) ;
+            }
+            return v ;
+        }
+
+        inline void write_all (int fd, const void *data, size_t size, const std::string &path) {
+            auto *  p = static_cast<const uint8_t *> (data) ;
+            while (0 < size) {
+                const ssize_t   r = ::write (fd, p, size) ;
+                if (r < 0 && errno == EINTR) {
+                    continue ;
+                }
+                if (r <= 0) {
+                    throw std::system_error { r < 0 ? errno : EIO, std::generic_category (), path } ;
+                }
+                p += r ;
+                size -= static_cast<size_t> (r) ;
+            }
+        }
+
+        inline void fail (std::errc e, const std::string &path) {
+            throw std::system_error { std::make_error_code (e), path } ;
+        }
+
+        /// Flushes the directory holding `path`, so a name just created (or renamed) there survives a power loss.
+        inline void sync_parent_directory (const std::string &path) {
+            const size_t        slash = path.rfind ('/') ;
+            const std::string   dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr (0, slash) ;
+            const int   fd = ::open (dir.c_str (), O_RDONLY | O_DIRECTORY | O_CLOEXEC) ;
+            if (fd < 0) {
+                throw std::system_error { errno, std::generic_category (), dir } ;
+            }
+            const int   r = ::fsync (fd) ;
+            const int   err = errno ;
+            ::close (fd) ;
+            if (r != 0) {
+                throw std::system_error { err, std::generic_category (), dir } ;
+            }
+        }
+    }
+
+    /**
+     * 64 bit checksum of the state words (their values, not their in-memory bytes).
+     * Four independent lanes keep it well ahead of disk bandwidth.
+     */
+    inline uint64_t checksum (const state_t *states, size_t count) {
+        const uint64_t  P1 = 0x9E3779B185EBCA87ull ;
+        const uint64_t  P2 = 0xC2B2AE3D27D4EB4Full ;
+        uint64_t    lane [4] = { P1 + P2, P2, 0, 0 - P1 } ;
+        size_t      i = 0 ;
+        for ( ; i + 2 <= count ; i += 2) {
+            for (size_t k = 0 ; k < 4 ; ++k) {
+                lane [k] = detail::rotl (lane [k] + states [i + k / 2][k % 2] * P2, 31) * P1 ;
+            }
+        }
+        if (i < count) {
+            lane [0] = detail::rotl (lane [0] + states [i][0] * P2, 31) * P1 ;
+            lane [1] = detail::rotl (lane [1] + states [i][1] * P2, 31) * P1 ;
+        }
+        uint64_t    h = detail::rotl (lane [0], 1) + detail::rotl (lane [1], 7) + detail::rotl (lane [2], 12) + detail::rotl (lane [3], 18) ;
+        h ^= static_cast<uint64_t> (count) ;
+        h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull ;
+        h = (h ^ (h >> 27)) * 0x94D049BB133111EBull ;
+        return h ^ (h >> 31) ;
+    }
+
+    /**
+     * Writes `count` states to `path`.
+     * The snapshot is written to `path + ".tmp"` and renamed over `path`, so readers never see
+     * a partial one.
+     *
+     * @param sync  Flushes the snapshot to disk before renaming it, and the directory after.
+     * @throw std::system_error on I/O errors.
+     */
+    inline void save (const std::string &path, kind_t kind, const state_t *states, size_t count, bool sync = true) {
+        uint8_t header [HEADER_SIZE] ;
+        memset (header, 0, sizeof (header)) ;
+        memcpy (header, detail::MAGIC, sizeof (detail::MAGIC)) ;
+        detail::store_le (header + 8, VERSION, 4) ;
+        detail::store_le (header + 12, static_cast<uint32_t> (kind), 4) ;
+        detail::store_le (header + 16, count, 8) ;
+        detail::store_le (header + 24, checksum (states, count), 8) ;
+
+        const std::string   tmp = path + ".tmp" ;
+        const int   fd = ::open (tmp.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644) ;
+        if (fd < 0) {
+            throw std::system_error { errno, std::generic_category (), tmp } ;
+        }
+        try {
+            detail::write_all (fd, header, sizeof (header), tmp) ;
+            if (! detail::big_endian ()) {
+                detail::write_all (fd, states, count * sizeof (state_t), tmp) ;
+            }
+            else {
+                std::vector<state_t>    buf ;
+                for (size_t i = 0 ; i < count ; i += 4096) {
+                    buf.assign (states + i, states + std::min (count, i + 4096)) ;
+                    for (auto &S : buf) {
+                        S [0] = detail::bswap (S [0]) ;
+                        S [1] = detail::bswap (S [1]) ;
+                    }
+                    detail::write_all (fd, buf.data (), buf.size () * sizeof (state_t), tmp) ;
+                }
+            }
+            if (sync && ::fsync (fd) != 0) {
+                throw std::system_error { errno, std::generic_category (), tmp } ;
+            }
+        }
+        catch (...) {
+            ::close (fd) ;
+            ::unlink (tmp.c_str ()) ;
+            throw ;
+        }
+        if (::close (fd) != 0 || ::rename (tmp.c_str (), path.c_str ()) != 0) {
+            const int   err = errno ;
+            ::unlink (tmp.c_str ()) ;
+            throw std::system_error { err, std::generic_category (), path } ;
+        }
+        if (sync) {
+            detail::sync_parent_directory (path) ;
+        }
+    }
+
+    inline void save (const std::string &path, kind_t kind, const std::vector<state_t> &states, bool sync = true) {
+        save (path, kind, states.data (), states.size (), sync) ;
+    }
+
+    /**
+     * States of a snapshot, mapped copy-on-write: They can be advanced in place without
+     * touching the file (only the modified pages are copied).
+     */
+    class mapped_states {
+        void *      base_ = nullptr ;
+        size_t      length_ = 0 ;
+        size_t      count_ = 0 ;
+        kind_t      kind_ = kind_t::xoroshiro128_plus ;
+
+        friend mapped_states    load (const std::string &path, kind_t expected, bool verify) ;
+    public:
+        mapped_states () = default ;
+
+        mapped_states (mapped_states &&other) noexcept
+                : base_ { other.base_ }, length_ { other.length_ }, count_ { other.count_ }, kind_ { other.kind_ } {
+            other.base_ = nullptr ;
+            other.length_ = other.count_ = 0 ;
+        }
+
+        mapped_states & operator = (mapped_states &&other) noexcept {
+            if (this != &other) {
+                this->~mapped_states () ;
+                new (this) mapped_states { std::move (other) } ;
+            }
+            return *this ;
+        }
+
+        mapped_states (const mapped_states &) = delete ;
+        mapped_states & operator = (const mapped_states &) = delete ;
+
+        ~mapped_states () {
+            if (base_ != nullptr) {
+                ::munmap (base_, length_) ;
+            }
+        }
+
+        kind_t      kind () const { return kind_ ; }
+        size_t      size () const { return count_ ; }
+        bool        empty () const { return count_ == 0 ; }
+
+        state_t *   data () {
+            return base_ == nullptr ? nullptr : reinterpret_cast<state_t *> (static_cast<uint8_t *> (base_) + HEADER_SIZE) ;
+        }
+        const state_t * data () const {
+            return const_cast<mapped_states *> (this)->data () ;
+        }
+
+        state_t *       begin () { return data () ; }
+        state_t *       end () { return data () + count_ ; }
+        const state_t * begin () const { return data () ; }
+        const state_t * end () const { return data () + count_ ; }
+
+        state_t &       operator [] (size_t i) { return data () [i] ; }
+        const state_t & operator [] (size_t i) const { return data () [i] ; }
+    } ;
+
+    /**
+     * Maps the snapshot at `path`.
+     * States are used in place on little-endian hosts (byte swapped in the private mapping otherwise).
+     *
+     * @param expected  Kind of generator the caller is resuming.
+     * @param verify    Checks the checksum (reads the whole file).
+     * @throw std::system_error on I/O errors, with `std::errc::invalid_argument` for malformed or
+     *        mismatching snapshots and `std::errc::illegal_byte_sequence` for checksum errors.
+     */
+    inline mapped_states    load (const std::string &path, kind_t expected, bool verify = true) {
+        const int   fd = ::open (path.c_str (), O_RDONLY) ;
+        if (fd < 0) {
+            throw std::system_error { errno, std::generic_category (), path } ;
+        }
+        struct stat st ;
+        if (::fstat (fd, &st) != 0) {
+            const int   err = errno ;
+            ::close (fd) ;
+            throw std::system_error { err, std::generic_category (), path } ;
+        }
+        const auto  size = static_cast<uint64_t> (st.st_size) ;
+        if (size < HEADER_SIZE) {
+            ::close (fd) ;
+            detail::fail (std::errc::invalid_argument, path) ;
+        }
+        mapped_states   result ;
+        result.length_ = static_cast<size_t> (size) ;
+        // Private & writable: Resumed states are advanced in place.
+        result.base_ = ::mmap (nullptr, result.length_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) ;
+        const int   err = errno ;
+        ::close (fd) ;
+        if (result.base_ == MAP_FAILED) {
+            result.base_ = nullptr ;
+            throw std::system_error { err, std::generic_category (), path } ;
+        }
+        const auto *    header = static_cast<const uint8_t *> (result.base_) ;
+        const uint64_t  count = detail::load_le (header + 16, 8) ;
+        if (memcmp (header, detail::MAGIC, sizeof (detail::MAGIC)) != 0
+            || detail::load_le (header + 8, 4) != VERSION
+            || detail::load_le (header + 12, 4) != static_cast<uint32_t> (expected)
+            || (size - HEADER_SIZE) / sizeof (state_t) != count
+            || (size - HEADER_SIZE) % sizeof (state_t) != 0) {
+            detail::fail (std::errc::invalid_argument, path) ;
+        }
+        result.count_ = static_cast<size_t> (count) ;
+        result.kind_ = expected ;
+        if (detail::big_endian ()) {
+            for (auto &S : result) {
+                S [0] = detail::bswap (S [0]) ;
+                S [1] = detail::bswap (S [1]) ;
+            }
+        }
+        if (verify) {
+#if defined (MADV_SEQUENTIAL)
+            ::madvise (result.base_, result.length_, MADV_SEQUENTIAL) ;
+#endif
+            if (checksum (result.data (), result.size ()) != detail::load_le (header + 24, 8)) {
+                detail::fail (std::errc::illegal_byte_sequence, path) ;
+            }
+#if defined (MADV_NORMAL)
+            ::madvise (result.base_, result.length_, MADV_NORMAL) ;
+#endif
+        }
+        return result ;
+    }
+}
+
+#endif /* checkpoint_hpp__A0E5C3B9_64D2_4F18_9B7A_1D8E2F6C4053 */
@@ -0,0 +1,246 @@
+/**
+ * contention.hpp: Instrumented lock-free `next` with exponential backoff and retry statistics.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef contention_hpp__2B5A0C1E_8D0F_4B1A_A7E2_9C54D3F1B6E8
+#define contention_hpp__2B5A0C1E_8D0F_4B1A_A7E2_9C54D3F1B6E8  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "xorshift.hpp"
+#include "xoroshiro.hpp"
+
+#if defined (_WIN32) || defined (_WIN64)
+#   include <intrin.h>
+#endif
+
+/**
+ * Enables the instrumented CAS loops (requires CMPXCHG16B).
+ */
+#ifndef CONTENTION_AVAILABLE
+#   if defined (__x86_64__) || defined (_WIN64) || XORSHIFT_LOCKFREE_BUILTIN
+#       define CONTENTION_AVAILABLE 1
+#   else
+#       define CONTENTION_AVAILABLE 0
+#   endif
+#endif
+
+namespace Contention {
+
+    /// Snapshot of the retry counters.
+    struct stats_t {
+        uint64_t    calls = 0 ;         ///< # of successful updates.
+        uint64_t    retries = 0 ;       ///< # of failed CAS attempts.
+        uint64_t    max_retries = 0 ;   ///< Longest retry streak of a single call.
+
+        stats_t &   operator += (const stats_t &other) {
+            calls += other.calls ;
+            retries += other.retries ;
+            max_retries = std::max (max_retries, other.max_retries) ;
+            return *this ;
+        }
+
+        /// Average # of failed attempts per successful update.
+        double  retries_per_call () const {
+            return calls == 0 ? 0.0 : static_cast<double> (retries) / static_cast<double> (calls) ;
+        }
+    } ;
+
+    /// Backoff parameters: the i-th retry spins `min (min_pause * 2^i, max_pause)` PAUSEs.
+    struct backoff_t {
+        uint32_t    min_pause = 1 ;
+        uint32_t    max_pause = 1024 ;
+    } ;
+
+    namespace detail {
+        /// Counters owned by a thread.  Only the owner writes, others read them when aggregating.
+        struct counters_t {
+            std::atomic<uint64_t>   calls { 0 } ;
+            std::atomic<uint64_t>   retries { 0 } ;
+            std::atomic<uint64_t>   max_retries { 0 } ;
+
+            stats_t snapshot () const {
+                stats_t result ;
+                result.calls = calls.load (std::memory_order_relaxed) ;
+                result.retries = retries.load (std::memory_order_relaxed) ;
+                result.max_retries = max_retries.load (std::memory_order_relaxed) ;
+                return result ;
+            }
+        } ;
+
+        struct registry_t {
+            std::mutex                  lock ;
+            std::vector<counters_t *>   live ;
+            stats_t                     retired ;   // Counts of already terminated threads.
+        } ;
+
+        inline registry_t & registry () {
+            static registry_t   r ;
+            return r ;
+        }
+
+        struct thread_counters_t {
+            counters_t  counters ;
+
+            thread_counters_t () {
+                auto &  R = registry () ;
+                std::lock_guard<std::mutex> guard (R.lock) ;
+                R.live.push_back (&counters) ;
+            }
+
+            ~thread_counters_t () {
+                auto &  R = registry () ;
+                std::lock_guard<std::mutex> guard (R.lock) ;
+                R.retired += counters.snapshot () ;
+                R.live.erase (std::remove (R.live.begin (), R.live.end (), &counters), R.live.end ()) ;
+            }
+        } ;
+
+        inline counters_t & thread_counters () {
+            thread_local thread_counters_t  C ;
+            return C.counters ;
+        }
+
+        inline void record (uint64_t retries) {
+            auto &  C = thread_counters () ;
+            // Owner-only updates, so plain load/store pairs suffice (no locked instructions).
+            C.calls.store (C.calls.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed) ;
+            C.retries.store (C.retries.load (std::memory_order_relaxed) + retries, std::memory_order_relaxed) ;
+            if (C.max_retries.load (std::memory_order_relaxed) < retries) {
+                C.max_retries.store (retries, std::memory_order_relaxed) ;
+            }
+        }
+    }
+
+    /// Counters of the calling thread.
+    inline stats_t  thread_stats () {
+        return detail::thread_counters ().snapshot () ;
+    }
+
+    /// Counters summed over every thread (including terminated ones).
+    inline stats_t  total_stats () {
+        auto &  R = detail::registry () ;
+        std::lock_guard<std::mutex> guard (R.lock) ;
+        stats_t result = R.retired ;
+        for (const auto *C : R.live) {
+            result += C->snapshot () ;
+        }
+        return result ;
+    }
+
+    /// Spin-wait hint.
+    inline void cpu_relax () {
+#if defined (_WIN32) || defined (_WIN64)
+        _mm_pause () ;
+#elif defined (__x86_64__) || defined (__i386__)
+        __builtin_ia32_pause () ;
+#endif
+    }
+
+#if CONTENTION_AVAILABLE
+
+    /**
+     * 128bit compare & exchange.
+     * Replaces `target` with `desired` if it equals to `expected`, otherwise stores the current value into `expected`.
+     */
+    inline bool compare_exchange (std::array<uint64_t, 2> &target, std::array<uint64_t, 2> &expected, const std::array<uint64_t, 2> &desired) {
+        // CMPXCHG16B requires destination was aligned to 16byte boundary.
+        assert ((reinterpret_cast<uintptr_t> (target.data ()) & 0xF) == 0) ;
+#if defined (_WIN32) || defined (_WIN64)
+        return _InterlockedCompareExchange128 ((volatile long long *)target.data (), desired [1], desired [0], (long long *)expected.data ()) != 0 ;
+#elif XORSHIFT_LOCKFREE_BUILTIN
+        using XorShift::detail::uint128_t ;
+        const uint128_t E = XorShift::detail::load (expected) ;
+        const uint128_t prev = __sync_val_compare_and_swap (reinterpret_cast<uint128_t *> (target.data ()), E, XorShift::detail::load (desired)) ;
+        expected [0] = static_cast<uint64_t> (prev) ;
+        expected [1] = static_cast<uint64_t> (prev >> 64) ;
+        return prev == E ;
+#else
+        uint64_t    ax = expected [0] ;
+        uint64_t    dx = expected [1] ;
+        uint8_t     done ;
+        __asm__ __volatile__ ("lock; cmpxchg16b (%3)  \n"
+                              "setz  %0  \n"
+                             : "=q" (done), "+a" (ax), "+d" (dx)
+                             : "r" (target.data ()), "b" (desired [0]), "c" (desired [1])
+                             : "memory", "cc") ;
+        expected [0] = ax ;
+        expected [1] = dx ;
+        return done != 0 ;
+#endif
+    }
+
+    namespace detail {
+        /// Runs CAS loop with `step` computing the desired state (and the result) from the expected one.
+        template <typename STEP_>
+            inline uint64_t update (std::array<uint64_t, 2> &state, const backoff_t &backoff, STEP_ step) {
+                alignas (16) std::array<uint64_t, 2>    expected = state ;
+                alignas (16) std::array<uint64_t, 2>    desired ;
+                uint32_t    pause = backoff.min_pause ;
+                uint64_t    retries = 0 ;
+                while (true) {
+                    const uint64_t  result = step (expected, desired) ;
+                    if (compare_exchange (state, expected, desired)) {
+                        record (retries) ;
+                        return result ;
+                    }
+                    ++retries ;
+                    for (uint32_t i = 0 ; i < pause ; ++i) {
+                        cpu_relax () ;
+                    }
+                    pause = std::min (pause * 2, backoff.max_pause) ;
+                }
+            }
+    }
+
+#endif  /* CONTENTION_AVAILABLE */
+}
+
+#if CONTENTION_AVAILABLE
+
+namespace XorShift {
+    /// Instrumented version of `XorShift::next` (backs off on CAS failure, counts retries).
+    inline uint64_t next (state_t &state, const Contention::backoff_t &backoff) {
+        return Contention::detail::update (state, backoff, [](const state_t &S, state_t &D) -> uint64_t {
+            uint_fast64_t s1 = S [0] ;
+            const uint_fast64_t s0 = S [1] ;
+            s1 ^= s1 << 23 ;
+            D [0] = s0 ;
+            D [1] = s1 ^ s0 ^ (s1 >> 18) ^ (s0 >> 5) ;
+            return D [1] + s0 ;
+        }) ;
+    }
+}
+
+namespace XoRoShiRo {
+    /// Instrumented version of `XoRoShiRo::next` (backs off on CAS failure, counts retries).
+    inline uint64_t next (state_t &state, const Contention::backoff_t &backoff) {
+        return Contention::detail::update (state, backoff, [](const state_t &S, state_t &D) -> uint64_t {
+            const uint64_t s0 = S [0] ;
+            uint64_t s1 = S [1] ;
+
+            auto rotl = [](uint64_t v, int cnt) -> uint64_t {
+                return (v << cnt) | (v >> (64 - cnt)) ;
+            } ;
+
+            s1 ^= s0 ;
+            D [0] = rotl (s0, 55) ^ s1 ^ (s1 << 14) ;
+            D [1] = rotl (s1, 36) ;
+            return S [0] + S [1] ;
+        }) ;
+    }
+}
+
+#endif  /* CONTENTION_AVAILABLE */
+
+#endif /* contention_hpp__2B5A0C1E_8D0F_4B1A_A7E2_9C54D3F1B6E8 */
@@ -0,0 +1,501 @@
+/**
+ * direct_writer.hpp: Streams random data to a file or a raw device, bypassing the page cache (POSIX).
+ *
+ * Uses io_uring (raw syscalls, no liburing) when the kernel supports it and falls back to a
+ * pwrite(2) thread otherwise.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef direct_writer_hpp__3F1C7A20_9B54_4D6E_A8E3_5C0D2B71E946
+#define direct_writer_hpp__3F1C7A20_9B54_4D6E_A8E3_5C0D2B71E946  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined (__linux__) && defined (__has_include)
+#   if __has_include (<linux/io_uring.h>)
+#       include <linux/io_uring.h>
+#       include <sys/syscall.h>
+        // IO_URING_OP_SUPPORTED comes with IORING_OP_WRITE and IORING_REGISTER_PROBE (Linux 5.6 headers).
+#       if defined (__NR_io_uring_setup) && defined (__NR_io_uring_enter) && defined (__NR_io_uring_register) && defined (IO_URING_OP_SUPPORTED)
+#           define XORSHIFT_IO_URING   1
+#       endif
+#   endif
+#endif
+#if ! defined (XORSHIFT_IO_URING)
+#   define XORSHIFT_IO_URING   0
+#endif
+
+#include "xoroshiro.hpp"
+
+namespace XoRoShiRo {
+
+    struct direct_write_options_t {
+        size_t  buffer_size = 1u << 20 ;    ///< Bytes per write (multiple of `DIRECT_ALIGN`).
+        size_t  queue_depth = 8 ;           ///< # of buffers (one is filled while the others are in flight).
+        bool    direct = true ;             ///< Opens with `O_DIRECT` (silently dropped if the file system refuses).
+        bool    io_uring = true ;           ///< Uses io_uring when available.
+        bool    sync = false ;              ///< `fdatasync` before returning.
+    } ;
+
+    /// What `write_file_direct` actually used.
+    struct direct_write_result_t {
+        bool    io_uring = false ;
+        bool    direct = false ;
+    } ;
+
+    namespace detail {
+        /// Alignment of `O_DIRECT` buffers, offsets and lengths (safe for 512e and 4Kn devices).
+        const size_t    DIRECT_ALIGN = 4096 ;
+
+        struct aligned_free {
+            void    operator () (void *p) const { ::free (p) ; }
+        } ;
+
+        /// Flat buffer ring: slot `i` is at `base + i * buffer_size`.
+        class buffer_ring {
+            std::unique_ptr<uint8_t, aligned_free>  base_ ;
+            size_t  buffer_size_ ;
+        public:
+            buffer_ring (size_t buffer_size, size_t count) : buffer_size_ { buffer_size } {
+                void *  p = nullptr ;
+                const int   err = ::posix_memalign (&p, DIRECT_ALIGN, buffer_size * count) ;
+                if (err != 0) {
+                    throw std::system_error { err, std::generic_category (), "buffer_ring" } ;
+                }
+                base_.reset (static_cast<uint8_t *> (p)) ;
+            }
+
+            uint8_t *   operator [] (size_t i) const {
+                return base_.get () + i * buffer_size_ ;
+            }
+        } ;
+
+        /// A write of one buffer, possibly resumed after a short write.
+        struct pending_write_t {
+            uint64_t    offset = 0 ;
+            size_t      done = 0 ;
+            size_t      length = 0 ;
+        } ;
+
+#if XORSHIFT_IO_URING
+        /// Minimal io_uring wrapper (single submitter, writes only).
+        class uring {
+            int         fd_ = -1 ;
+            void *      sq_ptr_ = MAP_FAILED ;
+            size_t      sq_size_ = 0 ;
+            void *      cq_ptr_ = MAP_FAILED ;
+            size_t      cq_size_ = 0 ;
+            io_uring_sqe *  sqes_ = static_cast<io_uring_sqe *> (MAP_FAILED) ;
+            size_t      sqes_size_ = 0 ;
+
+            uint32_t *  sq_tail_ = nullptr ;
+            uint32_t    sq_mask_ = 0 ;
+            uint32_t *  sq_array_ = nullptr ;
+            uint32_t *  cq_head_ = nullptr ;
+            uint32_t *  cq_tail_ = nullptr ;
+            uint32_t    cq_mask_ = 0 ;
+            io_uring_cqe *  cqes_ = nullptr ;
+            uint32_t    to_submit_ = 0 ;
+
+            void    release () {
+                if (sqes_ != MAP_FAILED) {
+                    ::munmap (sqes_, sqes_size_) ;
+                }
+                if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) {
+                    ::munmap (cq_ptr_, cq_size_) ;
+                }
+                if (sq_ptr_ != MAP_FAILED) {
+                    ::munmap (sq_ptr_, sq_size_) ;
+                }
+                if (0 <= fd_) {
+                    ::close (fd_) ;
+                }
+            }
+        public:
+            /// @throw std::system_error when the kernel (or a sandbox) does not allow io_uring.
+            explicit uring (unsigned entries) {
+                io_uring_params     p ;
+                ::memset (&p, 0, sizeof (p)) ;
+                fd_ = static_cast<int> (::syscall (__NR_io_uring_setup, entries, &p)) ;
+                if (fd_ < 0) {
+                    throw std::system_error { errno, std::generic_category (), "io_uring_setup" } ;
+                }
+                sq_size_ = p.sq_off.array + p.sq_entries * sizeof (uint32_t) ;
+                cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof (io_uring_cqe) ;
+                const bool  single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0 ;
+                if (single_mmap) {
+                    sq_size_ = cq_size_ = std::max (sq_size_, cq_size_) ;
+                }
+                sq_ptr_ = ::mmap (nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING) ;
+                if (sq_ptr_ != MAP_FAILED) {
+                    cq_ptr_ = single_mmap ? sq_ptr_ : ::mmap (nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING) ;
+                }
+                if (cq_ptr_ != MAP_FAILED) {
+                    sqes_size_ = p.sq_entries * sizeof (io_uring_sqe) ;
+                    sqes_ = static_cast<io_uring_sqe *> (::mmap (nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES)) ;
+                }
+                if (sqes_ == MAP_FAILED) {
+                    const int   err = errno ;
+                    release () ;
+                    throw std::system_error { err, std::generic_category (), "io_uring mmap" } ;
+                }
+                // Linux 5.1-5.5 set the ring up but fail every IORING_OP_WRITE with EINVAL.
+                if (! supports (IORING_OP_WRITE)) {
+                    release () ;
+                    throw std::system_error { EOPNOTSUPP, std::generic_category (), "IORING_OP_WRITE" } ;
+                }
+                auto *  sq = static_cast<uint8_t *> (sq_ptr_) ;
+                auto *  cq = static_cast<uint8_t *> (cq_ptr_) ;
+                sq_tail_ = reinterpret_cast<uint32_t *> (sq + p.sq_off.tail) ;
+                sq_mask_ = *reinterpret_cast<uint32_t *> (sq + p.sq_off.ring_mask) ;
+                sq_array_ = reinterpret_cast<uint32_t *> (sq + p.sq_off.array) ;
+                cq_head_ = reinterpret_cast<uint32_t *> (cq + p.cq_off.head) ;
+                cq_tail_ = reinterpret_cast<uint32_t *> (cq + p.cq_off.tail) ;
+                cq_mask_ = *reinterpret_cast<uint32_t *> (cq + p.cq_off.ring_mask) ;
+                cqes_ = reinterpret_cast<io_uring_cqe *> (cq + p.cq_off.cqes) ;
+            }
+
+            /// True when the kernel implements `opcode` (false on kernels without IORING_REGISTER_PROBE).
+            bool    supports (uint8_t opcode) const {
+                const size_t    ops = 256 ;
+                std::vector<uint64_t>   buf ((sizeof (io_uring_probe) + ops * sizeof (io_uring_probe_op) + 7) / 8) ;
+                auto *  probe = reinterpret_cast<io_uring_probe *> (buf.data ()) ;
+                if (::syscall (__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, ops) < 0) {
+                    return false ;
+                }
+                return opcode <= probe->last_op && opcode < probe->ops_len && (probe->ops [opcode].flags & IO_URING_OP_SUPPORTED) != 0 ;
+            }
+
+            uring (const uring &) = delete ;
+            uring & operator = (const uring &) = delete ;
+
+            ~uring () {
+                release () ;
+            }
+
+            /// Queues a write (submitted by the next `submit_and_wait`).
+            void    prepare_write (int fd, const void *buf, size_t len, uint64_t offset, uint64_t user_data) {
+                const uint32_t  tail = *sq_tail_ ;  // Only we write it.
+                const uint32_t  idx = tail & sq_mask_ ;
+                io_uring_sqe &  sqe = sqes_ [idx] ;
+                ::memset (&sqe, 0, sizeof (sqe)) ;
+                sqe.opcode = IORING_OP_WRITE ;
+                sqe.fd = fd ;
+                sqe.addr = reinterpret_cast<uint64_t> (buf) ;
+                sqe.len = static_cast<uint32_t> (len) ;
+                sqe.off = offset ;
+                sqe.user_data = user_data ;
+                sq_array_ [idx] = idx ;
+                __atomic_store_n (sq_tail_, tail + 1, __ATOMIC_RELEASE) ;
+                ++to_submit_ ;
+            }
+
+            /// Submits the queued writes and waits for at least `min_complete` completions.
+            void    submit_and_wait (unsigned min_complete) {
+                while (0 < to_submit_ || 0 < min_complete) {
+                    const long  r = ::syscall (__NR_io_uring_enter, fd_, to_submit_, min_complete
+                                              , min_complete != 0 ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0) ;
+                    if (r < 0) {
+                        if (errno == EINTR) {
+                            continue ;
+                        }
+                        throw std::system_error { errno, std::generic_category (), "io_uring_enter" } ;
+                    }
+                    to_submit_ -= static_cast<uint32_t> (r) ;
+                    min_complete = 0 ;
+                }
+            }
+
+            /// Pops one completion if any: Returns false when the completion queue is empty.
+            bool    pop (uint64_t &user_data, int32_t &res) {
+                const uint32_t  head = *cq_head_ ;
+                if (head == __atomic_load_n (cq_tail_, __ATOMIC_ACQUIRE)) {
+                    return false ;
+                }
+                const io_uring_cqe &    cqe = cqes_ [head & cq_mask_] ;
+                user_data = cqe.user_data ;
+                res = cqe.res ;
+                __atomic_store_n (cq_head_, head + 1, __ATOMIC_RELEASE) ;
+                return true ;
+            }
+        } ;
+#endif  /* XORSHIFT_IO_URING */
+
+        inline int  open_for_direct_write (const std::string &path, bool direct, bool &opened_direct) {
+            const int   flags = O_WRONLY | O_CREAT ;
+#if defined (O_DIRECT)
+            if (direct) {
+                const int   fd = ::open (path.c_str (), flags | O_DIRECT, 0644) ;
+                if (0 <= fd) {
+                    opened_direct = true ;
+                    return fd ;
+                }
+                if (errno != EINVAL) {
+                    throw std::system_error { errno, std::generic_category (), path } ;
+                }
+                // The file system does not support O_DIRECT (e.g. tmpfs).
+            }
+#else
+            (void)direct ;
+#endif
+            opened_direct = false ;
+            const int   fd = ::open (path.c_str (), flags, 0644) ;
+            if (fd < 0) {
+                throw std::system_error { errno, std::generic_category (), path } ;
+            }
+            return fd ;
+        }
+    }
+
+    /**
+     * Writes `size` bytes of `root`'s stream (the little-endian words of `unsafe_fill`) to `path`.
+     *
+     * `queue_depth` buffers rotate between the generator (the calling thread) and the I/O in
+     * flight, so generation overlaps with the writes.
+     * With `O_DIRECT` the last write of a regular file is padded to `DIRECT_ALIGN` and the file is
+     * truncated back to `size` afterwards.  Block devices are written in place (`size` should fit):
+     * Their unaligned tail goes through a buffered write instead, so no byte past `size` is touched.
+     *
+     * @throw std::system_error on I/O errors.
+     */
+    inline direct_write_result_t    write_file_direct (const std::string &path, uint64_t size, const state_t &root, const direct_write_options_t &opt = direct_write_options_t {}) {
+        using namespace detail ;
+        if (opt.buffer_size == 0 || opt.buffer_size % DIRECT_ALIGN != 0 || opt.queue_depth < 2 || (1u << 30) < opt.buffer_size) {
+            throw std::system_error { EINVAL, std::generic_category (), "write_file_direct: buffer_size/queue_depth" } ;
+        }
+        direct_write_result_t   result ;
+        const int   fd = open_for_direct_write (path, opt.direct, result.direct) ;
+        struct fd_closer {
+            int fd ;
+            ~fd_closer () { ::close (fd) ; }
+        } closer { fd } ;
+
+        struct stat     st ;
+        if (::fstat (fd, &st) != 0) {
+            throw std::system_error { errno, std::generic_category (), path } ;
+        }
+        const bool  regular = S_ISREG (st.st_mode) ;
+        if (regular && ::ftruncate (fd, 0) != 0) {
+            throw std::system_error { errno, std::generic_category (), path } ;
+        }
+
+        // Bytes written with O_DIRECT (a device's unaligned tail cannot be padded, it is written buffered below).
+        const uint64_t  body = regular || ! result.direct ? size : size - size % DIRECT_ALIGN ;
+        const size_t    depth = opt.queue_depth ;
+        buffer_ring     buffers { opt.buffer_size, depth } ;
+        state_t         S = root ;
+        uint64_t        generated = 0 ;
+
+        // Fills the buffer `slot` with the next chunk and returns the write to issue.
+        auto    generate = [&](size_t slot) -> pending_write_t {
+            pending_write_t w ;
+            w.offset = generated ;
+            const size_t    len = static_cast<size_t> (std::min<uint64_t> (opt.buffer_size, body - generated)) ;
+            auto *  out = reinterpret_cast<uint64_t *> (buffers [slot]) ;
+            unsafe_fill (S, out, (len + sizeof (uint64_t) - 1) / sizeof (uint64_t)) ;
+            w.length = result.direct ? (len + DIRECT_ALIGN - 1) / DIRECT_ALIGN * DIRECT_ALIGN : len ;
+            if (len < w.length) {
+                ::memset (buffers [slot] + len, 0, w.length - len) ;
+            }
+            generated += len ;
+            return w ;
+        } ;
+
+        std::vector<pending_write_t>    writes (depth) ;
+        bool    uring_done = false ;
+#if XORSHIFT_IO_URING
+        std::unique_ptr<uring>  ring ;
+        if (opt.io_uring) {
+            try {
+                ring.reset (new uring { static_cast<unsigned> (depth) }) ;
+            }
+            catch (const std::system_error &) {
+                // ENOSYS, EPERM (seccomp, io_uring_disabled), EOPNOTSUPP (no IORING_OP_WRITE)...: Falls back to pwrite.
+            }
+        }
+        if (ring) {
+            result.io_uring = true ;
+            std::vector<size_t> free_slots ;
+            for (size_t i = depth ; 0 < i ; --i) {
+                free_slots.push_back (i - 1) ;
+            }
+            size_t  in_flight = 0 ;
+            int     error = 0 ;
+            auto    submit = [&](size_t slot) {
+                const pending_write_t & w = writes [slot] ;
+                ring->prepare_write (fd, buffers [slot] + w.done, w.length - w.done, w.offset + w.done, slot) ;
+                ++in_flight ;
+            } ;
+            auto    reap = [&](unsigned min_complete) {
+                ring->submit_and_wait (min_complete) ;
+                uint64_t    slot ;
+                int32_t     res ;
+                while (ring->pop (slot, res)) {
+                    --in_flight ;
+                    pending_write_t &   w = writes [slot] ;
+                    if (res < 0) {
+                        if (error == 0) {
+                            error = -res ;
+                        }
+                        free_slots.push_back (slot) ;
+                    }
+                    else if (res == 0) {
+                        if (error == 0) {
+                            error = EIO ;
+                        }
+                        free_slots.push_back (slot) ;
+                    }
+                    else if ((w.done += static_cast<size_t> (res)) < w.length) {
+                        submit (slot) ;     // Short write: Resumes where it stopped.
+                    }
+                    else {
+                        free_slots.push_back (slot) ;
+                    }
+                }
+            } ;
+            while (generated < body && error == 0) {
+                if (free_slots.empty ()) {
+                    reap (1) ;
+                    continue ;
+                }
+                const size_t    slot = free_slots.back () ;
+                free_slots.pop_back () ;
+                writes [slot] = generate (slot) ;
+                submit (slot) ;
+                // Hands the write to the kernel right away and picks up whatever has completed.
+                reap (0) ;
+            }
+            while (0 < in_flight) {
+                reap (1) ;
+            }
+            if (error != 0) {
+                throw std::system_error { error, std::generic_category (), path } ;
+            }
+            uring_done = true ;
+        }
+#endif
+        if (! uring_done) {
+            // A writer thread issues the pwrite(2)s while this thread generates.
+            std::mutex                  mutex ;
+            std::condition_variable     cond ;
+            std::deque<size_t>  filled ;
+            std::vector<size_t> free_slots ;
+            for (size_t i = depth ; 0 < i ; --i) {
+                free_slots.push_back (i - 1) ;
+            }
+            bool    finished = false ;
+            int     error = 0 ;
+
+            std::thread writer { [&]() {
+                for (;;) {
+                    size_t  slot ;
+                    {
+                        std::unique_lock<std::mutex>    lock { mutex } ;
+                        cond.wait (lock, [&]() { return ! filled.empty () || finished ; }) ;
+                        if (filled.empty ()) {
+                            return ;
+                        }
+                        slot = filled.front () ;
+                        filled.pop_front () ;
+                    }
+                    pending_write_t &   w = writes [slot] ;
+                    int     err = 0 ;
+                    while (w.done < w.length) {
+                        const ssize_t   r = ::pwrite (fd, buffers [slot] + w.done, w.length - w.done, static_cast<off_t> (w.offset + w.done)) ;
+                        if (r < 0 && errno == EINTR) {
+                            continue ;
+                        }
+                        if (r <= 0) {
+                            err = r < 0 ? errno : EIO ;
+                            break ;
+                        }
+                        w.done += static_cast<size_t> (r) ;
+                    }
+                    std::lock_guard<std::mutex> lock { mutex } ;
+                    if (err != 0 && error == 0) {
+                        error = err ;
+                    }
+                    free_slots.push_back (slot) ;
+                    cond.notify_all () ;
+                }
+            } } ;
+
+            for (;;) {
+                size_t  slot ;
+                {
+                    std::unique_lock<std::mutex>    lock { mutex } ;
+                    cond.wait (lock, [&]() { return ! free_slots.empty () ; }) ;
+                    if (generated == body || error != 0) {
+                        finished = true ;
+                        cond.notify_all () ;
+                        break ;
+                    }
+                    slot = free_slots.back () ;
+                    free_slots.pop_back () ;
+                }
+                writes [slot] = generate (slot) ;
+                std::lock_guard<std::mutex> lock { mutex } ;
+                filled.push_back (slot) ;
+                cond.notify_all () ;
+            }
+            writer.join () ;
+            if (error != 0) {
+                throw std::system_error { error, std::generic_category (), path } ;
+            }
+        }
+
+        if (regular && result.direct && ::ftruncate (fd, static_cast<off_t> (size)) != 0) {
+            throw std::system_error { errno, std::generic_category (), path } ;
+        }
+        if (body < size) {
+            const size_t    len = static_cast<size_t> (size - body) ;
+            std::vector<uint64_t>   tail ((len + sizeof (uint64_t) - 1) / sizeof (uint64_t)) ;
+            unsafe_fill (S, tail.data (), tail.size ()) ;
+            const int   buffered = ::open (path.c_str (), O_WRONLY | O_CLOEXEC) ;
+            if (buffered < 0) {
+                throw std::system_error { errno, std::generic_category (), path } ;
+            }
+            fd_closer   buffered_closer { buffered } ;
+            const auto *    p = reinterpret_cast<const uint8_t *> (tail.data ()) ;
+            for (size_t done = 0 ; done < len ; ) {
+                const ssize_t   r = ::pwrite (buffered, p + done, len - done, static_cast<off_t> (body + done)) ;
+                if (r < 0 && errno == EINTR) {
+                    continue ;
+                }
+                if (r <= 0) {
+                    throw std::system_error { r < 0 ? errno : EIO, std::generic_category (), path } ;
+                }
+                done += static_cast<size_t> (r) ;
+            }
+            if (opt.sync && ::fdatasync (buffered) != 0) {
+                throw std::system_error { errno, std::generic_category (), path } ;
+            }
+        }
+        if (opt.sync && ::fdatasync (fd) != 0) {
+            throw std::system_error { errno, std::generic_category (), path } ;
+        }
+        return result ;
+    }
+}
+
+#endif /* direct_writer_hpp__3F1C7A20_9B54_4D6E_A8E3_5C0D2B71E946 */
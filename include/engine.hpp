@@ -0,0 +1,648 @@
+/**
+ * engine.hpp: Policy based xorshift family engine (recurrence x scrambler x threading).
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef engine_hpp__5D7C2B18_E3A9_4F06_91C4_8B2E6A0F3D75
+#define engine_hpp__5D7C2B18_E3A9_4F06_91C4_8B2E6A0F3D75  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+
+#if defined (__linux__)
+#   include <sched.h>
+#endif
+
+#include "contention.hpp"
+#include "xoroshiro.hpp"
+
+#if __cplusplus < 201402L && ! (defined (_MSVC_LANG) && 201402L <= _MSVC_LANG)
+#   error "engine.hpp requires C++14 (relaxed constexpr)."
+#endif
+
+/**
+ * `constexpr` for functions taking `state_t &` (see `XOROSHIRO_CONSTEXPR`).
+ */
+#define ENGINE_CONSTEXPR    XOROSHIRO_CONSTEXPR
+
+#ifndef XORSHIFT_CACHE_LINE_SIZE
+#   define XORSHIFT_CACHE_LINE_SIZE    64
+#endif
+
+namespace Engine {
+    using state_t = std::array<uint64_t, 2> ;
+
+    namespace detail {
+        constexpr uint64_t  rotl (uint64_t v, unsigned cnt) {
+            return (v << cnt) | (v >> (64 - cnt)) ;
+        }
+    }
+
+    /**
+     * State transitions.  `step (x, y)` advances (state [0], state [1]) by one.
+     * `SCRAMBLE_AFTER_STEP` tells whether the output is taken from the advanced state.
+     */
+    namespace recurrence {
+        /// xorshift128 (x: older half, y: newer half, as in `XorShift::state_t`).
+        template <unsigned A_, unsigned B_, unsigned C_>
+            struct xorshift128 {
+                static constexpr bool   SCRAMBLE_AFTER_STEP = true ;
+
+                static constexpr void   step (uint64_t &x, uint64_t &y) {
+                    uint64_t        s1 = x ;
+                    const uint64_t  s0 = y ;
+                    x = s0 ;
+                    s1 ^= s1 << A_ ;
+                    y = s1 ^ s0 ^ (s1 >> B_) ^ (s0 >> C_) ;
+                }
+            } ;
+
+        /// xoroshiro128.
+        template <unsigned A_, unsigned B_, unsigned C_>
+            struct xoroshiro128 {
+                static constexpr bool   SCRAMBLE_AFTER_STEP = false ;
+
+                static constexpr void   step (uint64_t &x, uint64_t &y) {
+                    const uint64_t  s0 = x ;
+                    const uint64_t  s1 = y ^ s0 ;
+                    x = detail::rotl (s0, A_) ^ s1 ^ (s1 << B_) ;
+                    y = detail::rotl (s1, C_) ;
+                }
+            } ;
+    }
+
+    /// Output functions of (state [0], state [1]).
+    namespace scrambler {
+        struct plus {
+            static constexpr uint64_t   apply (uint64_t x, uint64_t y) {
+                return x + y ;
+            }
+        } ;
+
+        template <uint64_t S_ = 5, unsigned R_ = 7, uint64_t T_ = 9>
+            struct star_star {
+                static constexpr uint64_t   apply (uint64_t x, uint64_t) {
+                    return detail::rotl (x * S_, R_) * T_ ;
+                }
+            } ;
+
+        template <unsigned R_ = 17>
+            struct plus_plus {
+                static constexpr uint64_t   apply (uint64_t x, uint64_t y) {
+                    return detail::rotl (x + y, R_) + x ;
+                }
+            } ;
+    }
+
+    namespace detail {
+        /// Polynomial over GF(2) of degree < 192.
+        struct gf2_poly {
+            uint64_t    w [3] ;
+
+            constexpr bool  bit (unsigned i) const {
+                return ((w [i / 64] >> (i % 64)) & 1) != 0 ;
+            }
+
+            constexpr void  flip (unsigned i) {
+                w [i / 64] ^= 1ull << (i % 64) ;
+            }
+
+            /// this ^= other * x^m
+            constexpr void  add_shifted (const gf2_poly &other, unsigned m) {
+                const unsigned  q = m / 64 ;
+                const unsigned  r = m % 64 ;
+                for (int i = 2 ; static_cast<int> (q) <= i ; --i) {
+                    uint64_t    v = other.w [i - q] << r ;
+                    if (r != 0 && q < static_cast<unsigned> (i)) {
+                        v |= other.w [i - q - 1] >> (64 - r) ;
+                    }
+                    w [i] ^= v ;
+                }
+            }
+        } ;
+
+        /**
+         * Characteristic polynomial of `R_` (degree 128 for full period recurrences),
+         * derived by Berlekamp-Massey from the lowest bit of state [0].
+         */
+        template <typename R_>
+            constexpr gf2_poly  characteristic_polynomial (unsigned &degree) {
+                const unsigned  N = 256 ;
+                uint8_t     bits [N] {} ;
+                uint64_t    x = 0x9E3779B97F4A7C15ull ;
+                uint64_t    y = 0xBF58476D1CE4E5B9ull ;
+                for (unsigned i = 0 ; i < N ; ++i) {
+                    bits [i] = static_cast<uint8_t> (x & 1) ;
+                    R_::step (x, y) ;
+                }
+                gf2_poly    C { { 1, 0, 0 } } ;     // Connection polynomial.
+                gf2_poly    B { { 1, 0, 0 } } ;
+                unsigned    L = 0 ;
+                unsigned    m = 1 ;
+                for (unsigned i = 0 ; i < N ; ++i) {
+                    unsigned    d = bits [i] ;
+                    for (unsigned j = 1 ; j <= L ; ++j) {
+                        d ^= (C.bit (j) ? 1u : 0u) & bits [i - j] ;
+                    }
+                    if (d == 0) {
+                        ++m ;
+                    }
+                    else if (2 * L <= i) {
+                        const gf2_poly  T = C ;
+                        C.add_shifted (B, m) ;
+                        L = i + 1 - L ;
+                        B = T ;
+                        m = 1 ;
+                    }
+                    else {
+                        C.add_shifted (B, m) ;
+                        ++m ;
+                    }
+                }
+                // The characteristic polynomial is the reciprocal of the connection polynomial.
+                gf2_poly    P { { 0, 0, 0 } } ;
+                for (unsigned j = 0 ; j <= L ; ++j) {
+                    if (C.bit (j)) {
+                        P.flip (L - j) ;
+                    }
+                }
+                degree = L ;
+                return P ;
+            }
+
+        /// a * b mod P (deg P == degree, deg a, deg b < degree).
+        constexpr gf2_poly  mul_mod (gf2_poly a, const gf2_poly &b, const gf2_poly &P, unsigned degree) {
+            gf2_poly    r { { 0, 0, 0 } } ;
+            for (unsigned i = 0 ; i < degree ; ++i) {
+                if (b.bit (i)) {
+                    for (unsigned k = 0 ; k < 3 ; ++k) {
+                        r.w [k] ^= a.w [k] ;
+                    }
+                }
+                a.w [2] = (a.w [2] << 1) | (a.w [1] >> 63) ;
+                a.w [1] = (a.w [1] << 1) | (a.w [0] >> 63) ;
+                a.w [0] <<= 1 ;
+                if (a.bit (degree)) {
+                    for (unsigned k = 0 ; k < 3 ; ++k) {
+                        a.w [k] ^= P.w [k] ;
+                    }
+                }
+            }
+            return r ;
+        }
+
+        /// x^(2^log2_steps) mod (characteristic polynomial of `R_`): Advances the state by 2^log2_steps.
+        template <typename R_>
+            constexpr gf2_poly  jump_polynomial (unsigned log2_steps) {
+                unsigned        degree = 0 ;
+                const gf2_poly  P = characteristic_polynomial<R_> (degree) ;
+                gf2_poly        r { { 2, 0, 0 } } ;     // x
+                for (unsigned i = 0 ; i < log2_steps ; ++i) {
+                    r = mul_mod (r, r, P, degree) ;
+                }
+                return r ;
+            }
+
+        template <typename R_>
+            constexpr unsigned  degree_of () {
+                unsigned    degree = 0 ;
+                characteristic_polynomial<R_> (degree) ;
+                return degree ;
+            }
+
+        /// state = q (A) state, where A is one step of `R_` (128 steps).
+        template <typename R_>
+            inline void apply_polynomial (const gf2_poly &q, state_t &state) {
+                uint64_t    x = state [0] ;
+                uint64_t    y = state [1] ;
+                uint64_t    s0 = 0 ;
+                uint64_t    s1 = 0 ;
+                for (unsigned b = 0 ; b < 128 ; ++b) {
+                    if (q.bit (b)) {
+                        s0 ^= x ;
+                        s1 ^= y ;
+                    }
+                    R_::step (x, y) ;
+                }
+                state [0] = s0 ;
+                state [1] = s1 ;
+            }
+
+        /**
+         * Random access into the stream of `R_`: `polys_ [k][d]` = x^(d * 256^k) mod P (k = 1..7),
+         * so any advance costs at most 7 polynomial applications and 255 single steps.
+         */
+        template <typename R_>
+            class advance_table {
+                gf2_poly    polys_ [8][256] ;
+            public:
+                advance_table () {
+                    static_assert (degree_of<R_> () == 128, "Recurrence should have full period.") ;
+                    unsigned        degree = 0 ;
+                    const gf2_poly  P = characteristic_polynomial<R_> (degree) ;
+                    gf2_poly        radix = jump_polynomial<R_> (8) ;   // x^256
+                    for (unsigned k = 1 ; k < 8 ; ++k) {
+                        polys_ [k][0] = gf2_poly { { 1, 0, 0 } } ;
+                        for (unsigned d = 1 ; d < 256 ; ++d) {
+                            polys_ [k][d] = mul_mod (polys_ [k][d - 1], radix, P, degree) ;
+                        }
+                        radix = mul_mod (polys_ [k][255], radix, P, degree) ;   // x^(256^(k + 1))
+                    }
+                }
+
+                /// Shared (lazily built) table of `R_`.
+                static const advance_table &    instance () {
+                    static const advance_table  table ;
+                    return table ;
+                }
+
+                /// Advances `state` by `n` steps in bounded time.
+                void    advance (state_t &state, uint64_t n) const {
+                    for (unsigned k = 7 ; 0 < k ; --k) {
+                        const unsigned  d = static_cast<unsigned> (n >> (8 * k)) & 0xFF ;
+                        if (d != 0) {
+                            apply_polynomial<R_> (polys_ [k][d], state) ;
+                        }
+                    }
+                    uint64_t    x = state [0] ;
+                    uint64_t    y = state [1] ;
+                    for (unsigned i = 0 ; i < (n & 0xFF) ; ++i) {
+                        R_::step (x, y) ;
+                    }
+                    state [0] = x ;
+                    state [1] = y ;
+                }
+            } ;
+    }
+
+    /**
+     * Thread agnostic operations of a recurrence / scrambler pair, all of them
+     * constant folded for the given constants.
+     */
+    template <typename Recurrence_, typename Scrambler_>
+        struct core {
+            using recurrence_type = Recurrence_ ;
+            using scrambler_type = Scrambler_ ;
+
+            static ENGINE_CONSTEXPR uint64_t    unsafe_next (state_t &state) {
+                uint64_t    x = state [0] ;
+                uint64_t    y = state [1] ;
+                const uint64_t  before = Scrambler_::apply (x, y) ;
+                Recurrence_::step (x, y) ;
+                state [0] = x ;
+                state [1] = y ;
+                return Recurrence_::SCRAMBLE_AFTER_STEP ? Scrambler_::apply (x, y) : before ;
+            }
+
+            /// Stores next `count` values into `out` (keeps the state in registers).
+            static ENGINE_CONSTEXPR void    unsafe_fill (state_t &state, uint64_t *out, size_t count) {
+                uint64_t    x = state [0] ;
+                uint64_t    y = state [1] ;
+                for (size_t i = 0 ; i < count ; ++i) {
+                    if (Recurrence_::SCRAMBLE_AFTER_STEP) {
+                        Recurrence_::step (x, y) ;
+                        out [i] = Scrambler_::apply (x, y) ;
+                    }
+                    else {
+                        out [i] = Scrambler_::apply (x, y) ;
+                        Recurrence_::step (x, y) ;
+                    }
+                }
+                state [0] = x ;
+                state [1] = y ;
+            }
+
+            /// Advances `state` by 2^64 steps (the jump polynomial is derived at compile time).
+            static ENGINE_CONSTEXPR state_t &   unsafe_jump (state_t &state) {
+                static_assert (detail::degree_of<Recurrence_> () == 128, "Recurrence should have full period.") ;
+                constexpr detail::gf2_poly  JUMP = detail::jump_polynomial<Recurrence_> (64) ;
+                uint64_t    x = state [0] ;
+                uint64_t    y = state [1] ;
+                uint64_t    s0 = 0 ;
+                uint64_t    s1 = 0 ;
+                for (unsigned b = 0 ; b < 128 ; ++b) {
+                    if (JUMP.bit (b)) {
+                        s0 ^= x ;
+                        s1 ^= y ;
+                    }
+                    Recurrence_::step (x, y) ;
+                }
+                state [0] = s0 ;
+                state [1] = s1 ;
+                return state ;
+            }
+        } ;
+
+    /// Expands a 64 bit seed into a (never all zero) state with SplitMix64.
+    ENGINE_CONSTEXPR state_t    seed_state (uint64_t seed) {
+        return XoRoShiRo::seed_state (seed) ;
+    }
+
+    /**
+     * Who may call the engine and how its state is stored.
+     * `storage<Core_>` provides `next`, `fill` and `jump` (and `state` where it is meaningful).
+     */
+    namespace threading {
+        /// Single owner: Plain state, no atomic ops.
+        struct none {
+            template <typename Core_>
+                class storage {
+                    state_t state_ ;
+                public:
+                    explicit storage (const state_t &S) : state_ (S) {
+                        /* NO-OP */
+                    }
+
+                    uint64_t    next () {
+                        return Core_::unsafe_next (state_) ;
+                    }
+
+                    void    fill (uint64_t *out, size_t count) {
+                        Core_::unsafe_fill (state_, out, count) ;
+                    }
+
+                    void    jump () {
+                        Core_::unsafe_jump (state_) ;
+                    }
+
+                    state_t state () const {
+                        return state_ ;
+                    }
+                } ;
+        } ;
+
+        /**
+         * Shared by any # of threads, wait-free: Every call claims indices with a single `fetch_add`
+         * and computes the state at that index, starting from the calling thread's last state when
+         * possible (a few steps under contention) or through `detail::advance_table` otherwise.
+         * The stream is 2^64 values long (no `jump`).
+         */
+        struct wait_free {
+            template <typename Core_>
+                class storage {
+                    using table_t = detail::advance_table<typename Core_::recurrence_type> ;
+
+                    /// Per-thread state of the last used instance.
+                    struct cache_t {
+                        uint64_t    owner = 0 ;
+                        uint64_t    index = 0 ;
+                        state_t     state {} ;
+                    } ;
+
+                    alignas (XORSHIFT_CACHE_LINE_SIZE) std::atomic<uint64_t>   index_ { 0 } ;
+                    alignas (XORSHIFT_CACHE_LINE_SIZE) state_t  base_ ;
+                    uint64_t        id_ ;
+                    const table_t & table_ ;
+
+                    static cache_t &    thread_cache () {
+                        thread_local cache_t    cache ;
+                        return cache ;
+                    }
+
+                    static uint64_t new_id () {
+                        static std::atomic<uint64_t>    last { 0 } ;
+                        return last.fetch_add (1) + 1 ;
+                    }
+
+                    state_t state_at (uint64_t n) const {
+                        const cache_t & c = thread_cache () ;
+                        state_t     S = base_ ;
+                        uint64_t    delta = n ;
+                        if (c.owner == id_ && c.index <= n) {
+                            S = c.state ;
+                            delta = n - c.index ;
+                        }
+                        table_.advance (S, delta) ;
+                        return S ;
+                    }
+
+                    void    remember (uint64_t n, const state_t &S) {
+                        cache_t &   c = thread_cache () ;
+                        c.owner = id_ ;
+                        c.index = n ;
+                        c.state = S ;
+                    }
+                public:
+                    explicit storage (const state_t &S) : base_ (S), id_ { new_id () }, table_ (table_t::instance ()) {
+                        /* NO-OP */
+                    }
+
+                    uint64_t    next () {
+                        const uint64_t  n = index_.fetch_add (1, std::memory_order_relaxed) ;
+                        state_t         S = state_at (n) ;
+                        const uint64_t  result = Core_::unsafe_next (S) ;
+                        remember (n + 1, S) ;
+                        return result ;
+                    }
+
+                    void    fill (uint64_t *out, size_t count) {
+                        const uint64_t  n = index_.fetch_add (count, std::memory_order_relaxed) ;
+                        state_t         S = state_at (n) ;
+                        Core_::unsafe_fill (S, out, count) ;
+                        remember (n + count, S) ;
+                    }
+
+                    /// State at the next unclaimed index.
+                    state_t state () const {
+                        return state_at (index_.load ()) ;
+                    }
+
+                    /// # of values handed out so far (modulo 2^64).
+                    uint64_t    index () const {
+                        return index_.load () ;
+                    }
+                } ;
+        } ;
+
+#if CONTENTION_AVAILABLE
+        /// Shared by any # of threads: 128 bit CAS on a single state.
+        struct cas {
+            template <typename Core_>
+                class storage {
+                    alignas (XORSHIFT_CACHE_LINE_SIZE) state_t  state_ ;
+                    Contention::backoff_t   backoff_ ;
+                public:
+                    explicit storage (const state_t &S, const Contention::backoff_t &backoff = Contention::backoff_t {})
+                            : state_ (S), backoff_ (backoff) {
+                        /* NO-OP */
+                    }
+
+                    uint64_t    next () {
+                        return Contention::detail::update (state_, backoff_, [](const state_t &S, state_t &D) -> uint64_t {
+                            D = S ;
+                            return Core_::unsafe_next (D) ;
+                        }) ;
+                    }
+
+                    /// Claims `count` consecutive values at once (retried as a whole on conflict).
+                    void    fill (uint64_t *out, size_t count) {
+                        Contention::detail::update (state_, backoff_, [out, count](const state_t &S, state_t &D) -> uint64_t {
+                            D = S ;
+                            Core_::unsafe_fill (D, out, count) ;
+                            return 0 ;
+                        }) ;
+                    }
+
+                    void    jump () {
+                        Contention::detail::update (state_, backoff_, [](const state_t &S, state_t &D) -> uint64_t {
+                            D = S ;
+                            Core_::unsafe_jump (D) ;
+                            return 0 ;
+                        }) ;
+                    }
+
+                    state_t state () const {
+                        // Atomic snapshot: CAS the observed value with itself.
+                        auto &  target = const_cast<state_t &> (state_) ;
+                        alignas (16) state_t    expected = state_ ;
+                        while (! Contention::compare_exchange (target, expected, state_t (expected))) {
+                            /* NO-OP: `expected` was refreshed */
+                        }
+                        return expected ;
+                    }
+                } ;
+        } ;
+
+        /**
+         * Shared by any # of threads: One jump-separated stream per CPU, picked by `sched_getcpu`.
+         * Threads migrating between the lookup and the update are covered by CAS.
+         */
+        struct per_cpu {
+            template <typename Core_>
+                class storage {
+                    struct alignas (XORSHIFT_CACHE_LINE_SIZE) slot_t {
+                        state_t state ;
+                    } ;
+                    std::unique_ptr<slot_t []>  slots_ ;
+                    size_t  count_ ;
+                    Contention::backoff_t   backoff_ ;
+
+                    state_t &   local () {
+#if defined (__linux__)
+                        const int   cpu = ::sched_getcpu () ;
+                        if (0 <= cpu) {
+                            return slots_ [static_cast<size_t> (cpu) % count_].state ;
+                        }
+#endif
+                        return slots_ [std::hash<std::thread::id> {} (std::this_thread::get_id ()) % count_].state ;
+                    }
+                public:
+                    explicit storage (const state_t &S, const Contention::backoff_t &backoff = Contention::backoff_t {})
+                            : count_ { std::max (1u, std::thread::hardware_concurrency ()) }
+                            , backoff_ (backoff) {
+                        slots_.reset (new slot_t [count_]) ;
+                        state_t T = S ;
+                        for (size_t i = 0 ; i < count_ ; ++i) {
+                            slots_ [i].state = T ;
+                            Core_::unsafe_jump (T) ;
+                        }
+                    }
+
+                    uint64_t    next () {
+                        return Contention::detail::update (local (), backoff_, [](const state_t &S, state_t &D) -> uint64_t {
+                            D = S ;
+                            return Core_::unsafe_next (D) ;
+                        }) ;
+                    }
+
+                    void    fill (uint64_t *out, size_t count) {
+                        Contention::detail::update (local (), backoff_, [out, count](const state_t &S, state_t &D) -> uint64_t {
+                            D = S ;
+                            Core_::unsafe_fill (D, out, count) ;
+                            return 0 ;
+                        }) ;
+                    }
+
+                    /// Moves every per-CPU stream past all of them (keeps them disjoint).
+                    void    jump () {
+                        for (size_t i = 0 ; i < count_ ; ++i) {
+                            Contention::detail::update (slots_ [i].state, backoff_, [this](const state_t &S, state_t &D) -> uint64_t {
+                                D = S ;
+                                for (size_t k = 0 ; k < count_ ; ++k) {
+                                    Core_::unsafe_jump (D) ;
+                                }
+                                return 0 ;
+                            }) ;
+                        }
+                    }
+
+                    /// # of per-CPU streams.
+                    size_t  streams () const {
+                        return count_ ;
+                    }
+                } ;
+        } ;
+#endif  /* CONTENTION_AVAILABLE */
+    }
+
+    /**
+     * UniformRandomBitGenerator over `core<Recurrence_, Scrambler_>`, stored according to `Threading_`.
+     */
+    template <typename Recurrence_, typename Scrambler_ = scrambler::plus, typename Threading_ = threading::none>
+        class engine {
+        public:
+            using core_type = core<Recurrence_, Scrambler_> ;
+            using result_type = uint64_t ;
+        private:
+            typename Threading_::template storage<core_type>    storage_ ;
+        public:
+            explicit engine (uint64_t seed = 0) : storage_ (seed_state (seed)) {
+                /* NO-OP */
+            }
+
+            explicit engine (const state_t &state) : storage_ (state) {
+                /* NO-OP */
+            }
+
+            static constexpr result_type    min () { return 0 ; }
+            static constexpr result_type    max () { return std::numeric_limits<result_type>::max () ; }
+
+            result_type operator () () {
+                return storage_.next () ;
+            }
+
+            /// Stores next `count` values into `out`.
+            void    fill (uint64_t *out, size_t count) {
+                storage_.fill (out, count) ;
+            }
+
+            /// Advances by 2^64 steps.
+            void    jump () {
+                storage_.jump () ;
+            }
+
+            /// Current state (for the policies holding a single one).
+            template <typename S_ = typename Threading_::template storage<core_type>>
+                auto    state () const -> decltype (std::declval<const S_ &> ().state ()) {
+                    return storage_.state () ;
+                }
+
+            const typename Threading_::template storage<core_type> &    storage () const {
+                return storage_ ;
+            }
+        } ;
+
+    template <typename Threading_ = threading::none>
+        using xorshift128_plus = engine<recurrence::xorshift128<23, 18, 5>, scrambler::plus, Threading_> ;
+
+    template <typename Threading_ = threading::none>
+        using xoroshiro128_plus = engine<recurrence::xoroshiro128<55, 14, 36>, scrambler::plus, Threading_> ;
+
+    template <typename Threading_ = threading::none>
+        using xoroshiro128_star_star = engine<recurrence::xoroshiro128<24, 16, 37>, scrambler::star_star<5, 7, 9>, Threading_> ;
+
+    template <typename Threading_ = threading::none>
+        using xoroshiro128_plus_plus = engine<recurrence::xoroshiro128<49, 21, 28>, scrambler::plus_plus<17>, Threading_> ;
+}
+
+#endif /* engine_hpp__5D7C2B18_E3A9_4F06_91C4_8B2E6A0F3D75 */
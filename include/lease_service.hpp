@@ -0,0 +1,531 @@
+/**
+ * lease_service.hpp: Hands out non-overlapping xoroshiro128+ streams to local processes over a Unix domain socket.
+ *
+ * Protocol (all integers little-endian).  A client may send any # of requests before reading
+ * the responses, which come back in the same order:
+ *
+ *      request (16 bytes)
+ *           0     4    magic "XSLQ"
+ *           4     4    # of streams (1..MAX_STREAMS)
+ *           8     8    tag (echoed back)
+ *
+ *      response (32 + 16*N bytes)
+ *           0     4    magic "XSLR"
+ *           4     4    status (0: OK, otherwise no streams follow)
+ *           8     4    # of streams (N)
+ *          12     4    reserved (0)
+ *          16     8    tag
+ *          24     8    index of the first stream (streams are numbered from the server's root)
+ *          32  16*N    streams: s[0], s[1] of each
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef lease_service_hpp__2B8E4D17_A6C3_4F09_9E52_D0713C6B8FA4
+#define lease_service_hpp__2B8E4D17_A6C3_4F09_9E52_D0713C6B8FA4  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "checkpoint.hpp"
+#include "engine.hpp"
+#include "substream.hpp"
+#include "xoroshiro.hpp"
+
+namespace LeaseService {
+
+    using state_t = XoRoShiRo::state_t ;
+
+    const uint32_t  MAX_STREAMS = 65536 ;           ///< Max. # of streams in a single request.
+    const size_t    REQUEST_SIZE = 16 ;
+    const size_t    RESPONSE_HEADER_SIZE = 32 ;
+
+    /**
+     * Unsent response bytes above which the server stops reading a connection's requests (backpressure):
+     * A client that pipelines requests without reading the responses cannot grow the server's memory further.
+     */
+    const size_t    OUTPUT_HIGH_WATER = 4u << 20 ;
+
+    enum class status_t : uint32_t {
+        ok = 0,
+        bad_request = 1,
+    } ;
+
+    /// Distance between consecutive streams.
+    enum class stride_t {
+        jump,           ///< 2^64 steps (`XoRoShiRo::jump`).
+        long_jump,      ///< 2^96 steps: Every stream can itself be split into 2^32 jump-separated ones.
+    } ;
+
+    namespace detail {
+        const uint32_t  REQUEST_MAGIC = 0x514C5358u ;   // "XSLQ"
+        const uint32_t  RESPONSE_MAGIC = 0x524C5358u ;  // "XSLR"
+
+        using Checkpoint::detail::load_le ;
+        using Checkpoint::detail::store_le ;
+
+        /// Unparsed request bytes kept per connection (reading stops there until they are answered).
+        const size_t    INPUT_LIMIT = 4096 * REQUEST_SIZE ;
+
+        inline void fail_errno (const std::string &what) {
+            throw std::system_error { errno, std::generic_category (), what } ;
+        }
+
+        inline sockaddr_un  address_of (const std::string &path) {
+            sockaddr_un addr ;
+            memset (&addr, 0, sizeof (addr)) ;
+            addr.sun_family = AF_UNIX ;
+            if (sizeof (addr.sun_path) <= path.size ()) {
+                throw std::system_error { std::make_error_code (std::errc::filename_too_long), path } ;
+            }
+            memcpy (addr.sun_path, path.c_str (), path.size () + 1) ;
+            return addr ;
+        }
+
+        /// True when a server accepts connections on `addr` (false for a stale socket file).
+        inline bool listening (const sockaddr_un &addr) {
+            const int   fd = ::socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) ;
+            if (fd < 0) {
+                fail_errno (addr.sun_path) ;
+            }
+            const bool  result = ::connect (fd, reinterpret_cast<const sockaddr *> (&addr), sizeof (addr)) == 0 ;
+            ::close (fd) ;
+            return result ;
+        }
+
+        /// Tabulated 2^96 step jump of xoroshiro128+ (the polynomial is derived at compile time).
+        inline const Substream::jump_table_t &  long_jump_table () {
+            using recurrence_t = Engine::recurrence::xoroshiro128<55, 14, 36> ;
+            static const Substream::jump_table_t    table { [](state_t &S) {
+                constexpr Engine::detail::gf2_poly  LONG_JUMP = Engine::detail::jump_polynomial<recurrence_t> (96) ;
+                Engine::detail::apply_polynomial<recurrence_t> (LONG_JUMP, S) ;
+            } } ;
+            return table ;
+        }
+    }
+
+    /**
+     * Owns the root state and serves requests until `stop`.
+     *
+     * Single threaded, event driven (`poll`): Every request already received from a client is
+     * answered in one batch, with one `write` per client and wakeup.
+     */
+    class server {
+        struct connection_t {
+            int                     fd ;
+            std::vector<uint8_t>    in ;
+            std::vector<uint8_t>    out ;
+            size_t                  written = 0 ;   // Bytes of `out` already sent.
+
+            /// True while the unsent responses are above the high-water mark (requests are left unread).
+            bool    backlogged () const {
+                return OUTPUT_HIGH_WATER <= out.size () - written ;
+            }
+        } ;
+
+        std::string     path_ ;
+        ino_t           inode_ = 0 ;        // Of the socket file we bound (removed on destruction if still ours).
+        int             listen_fd_ = -1 ;
+        int             wake_ [2] = { -1, -1 } ;
+        state_t         root_ ;
+        const Substream::jump_table_t & stride_ ;
+        std::atomic<uint64_t>   issued_ { 0 } ;
+        std::atomic<uint64_t>   requests_ { 0 } ;
+
+        void    close_all () {
+            for (int fd : { listen_fd_, wake_ [0], wake_ [1] }) {
+                if (0 <= fd) {
+                    ::close (fd) ;
+                }
+            }
+        }
+
+        /// Answers the complete requests in `c.in`, up to the high-water mark.
+        void    process (connection_t &c) {
+            if (0 < c.written) {
+                c.out.erase (c.out.begin (), c.out.begin () + static_cast<ptrdiff_t> (c.written)) ;
+                c.written = 0 ;
+            }
+            size_t  pos = 0 ;
+            for ( ; pos + REQUEST_SIZE <= c.in.size () && ! c.backlogged () ; pos += REQUEST_SIZE) {
+                const uint8_t * q = c.in.data () + pos ;
+                const uint32_t  count = static_cast<uint32_t> (detail::load_le (q + 4, 4)) ;
+                const bool      valid = detail::load_le (q, 4) == detail::REQUEST_MAGIC && 0 < count && count <= MAX_STREAMS ;
+                const size_t    n = valid ? count : 0 ;
+                const uint64_t  index = issued_.load (std::memory_order_relaxed) ;
+
+                const size_t    base = c.out.size () ;
+                c.out.resize (base + RESPONSE_HEADER_SIZE + n * sizeof (state_t)) ;
+                uint8_t *   r = c.out.data () + base ;
+                detail::store_le (r, detail::RESPONSE_MAGIC, 4) ;
+                detail::store_le (r + 4, static_cast<uint32_t> (valid ? status_t::ok : status_t::bad_request), 4) ;
+                detail::store_le (r + 8, n, 4) ;
+                detail::store_le (r + 12, 0, 4) ;
+                memcpy (r + 16, q + 8, 8) ;
+                detail::store_le (r + 24, index, 8) ;
+                r += RESPONSE_HEADER_SIZE ;
+                for (size_t i = 0 ; i < n ; ++i) {
+                    detail::store_le (r, root_ [0], 8) ;
+                    detail::store_le (r + 8, root_ [1], 8) ;
+                    r += sizeof (state_t) ;
+                    stride_.apply (root_, root_) ;
+                }
+                issued_.store (index + n, std::memory_order_relaxed) ;
+                requests_.fetch_add (1, std::memory_order_relaxed) ;
+            }
+            c.in.erase (c.in.begin (), c.in.begin () + static_cast<ptrdiff_t> (pos)) ;
+        }
+
+        /// Returns false when the connection should be dropped.
+        bool    receive (connection_t &c) {
+            uint8_t buf [64 * 1024] ;
+            while (c.in.size () < detail::INPUT_LIMIT) {
+                const ssize_t   r = ::recv (c.fd, buf, std::min (sizeof (buf), detail::INPUT_LIMIT - c.in.size ()), 0) ;
+                if (0 < r) {
+                    c.in.insert (c.in.end (), buf, buf + r) ;
+                    continue ;
+                }
+                if (r < 0 && errno == EINTR) {
+                    continue ;
+                }
+                if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break ;
+                }
+                return false ;  // EOF or error
+            }
+            process (c) ;
+            return true ;
+        }
+
+        /// Returns false when the connection should be dropped.
+        bool    send (connection_t &c) {
+            while (c.written < c.out.size ()) {
+                const ssize_t   r = ::send (c.fd, c.out.data () + c.written, c.out.size () - c.written, MSG_NOSIGNAL) ;
+                if (0 < r) {
+                    c.written += static_cast<size_t> (r) ;
+                    continue ;
+                }
+                if (r < 0 && errno == EINTR) {
+                    continue ;
+                }
+                return r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ;
+            }
+            c.out.clear () ;
+            c.written = 0 ;
+            return true ;
+        }
+    public:
+        /**
+         * Listens on `path` (a stale socket file left by a dead server is replaced).
+         * Stream i is `root` advanced by i strides.
+         * @throw std::system_error on errors, with `std::errc::file_exists` when `path` is not a socket and
+         *        `std::errc::address_in_use` when a live server listens on it.
+         */
+        server (const std::string &path, const state_t &root, stride_t stride = stride_t::jump)
+                : path_ { path }
+                , root_ (root)
+                , stride_ (stride == stride_t::jump ? XoRoShiRo::jump_table () : detail::long_jump_table ()) {
+            const sockaddr_un   addr = detail::address_of (path) ;
+            listen_fd_ = ::socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0) ;
+            try {
+                if (listen_fd_ < 0) {
+                    detail::fail_errno (path) ;
+                }
+                struct stat st ;
+                if (::lstat (path.c_str (), &st) == 0) {
+                    if (! S_ISSOCK (st.st_mode)) {
+                        throw std::system_error { std::make_error_code (std::errc::file_exists), path } ;
+                    }
+                    if (detail::listening (addr)) {
+                        throw std::system_error { std::make_error_code (std::errc::address_in_use), path } ;
+                    }
+                    ::unlink (path.c_str ()) ;
+                }
+                if (::bind (listen_fd_, reinterpret_cast<const sockaddr *> (&addr), sizeof (addr)) != 0
+                    || ::listen (listen_fd_, SOMAXCONN) != 0
+                    || ::pipe2 (wake_, O_NONBLOCK | O_CLOEXEC) != 0
+                    || ::lstat (path.c_str (), &st) != 0) {
+                    detail::fail_errno (path) ;
+                }
+                inode_ = st.st_ino ;
+            }
+            catch (...) {
+                close_all () ;
+                throw ;
+            }
+        }
+
+        server (const server &) = delete ;
+        server &    operator = (const server &) = delete ;
+
+        ~server () {
+            close_all () ;
+            struct stat st ;
+            if (0 < inode_ && ::lstat (path_.c_str (), &st) == 0 && st.st_ino == inode_) {
+                ::unlink (path_.c_str ()) ;
+            }
+        }
+
+        /// Serves clients until `stop` is called.
+        void    serve () {
+            std::vector<std::unique_ptr<connection_t>>  conns ;
+            std::vector<pollfd>     fds ;
+            while (true) {
+                fds.clear () ;
+                fds.push_back (pollfd { wake_ [0], POLLIN, 0 }) ;
+                fds.push_back (pollfd { listen_fd_, POLLIN, 0 }) ;
+                for (const auto &c : conns) {
+                    const short events = (c->backlogged () ? 0 : POLLIN) | (c->out.empty () ? 0 : POLLOUT) ;
+                    fds.push_back (pollfd { c->fd, events, 0 }) ;
+                }
+                if (::poll (fds.data (), fds.size (), -1) < 0) {
+                    if (errno == EINTR) {
+                        continue ;
+                    }
+                    detail::fail_errno (path_) ;
+                }
+                if (fds [0].revents != 0) {
+                    break ;
+                }
+                for (size_t i = 0 ; i < conns.size () ; ++i) {
+                    connection_t &  c = *conns [i] ;
+                    const short     ev = fds [2 + i].revents ;
+                    bool    alive = true ;
+                    if (ev & (POLLIN | POLLHUP | POLLERR)) {
+                        alive = receive (c) ;
+                    }
+                    while (alive && ! c.out.empty ()) {
+                        alive = send (c) ;
+                        if (! c.out.empty () || c.in.size () < REQUEST_SIZE) {
+                            break ;
+                        }
+                        process (c) ;   // Requests held back by the high-water mark.
+                    }
+                    if (! alive) {
+                        ::close (c.fd) ;
+                        c.fd = -1 ;
+                    }
+                }
+                for (size_t i = 0 ; i < conns.size () ; ) {
+                    if (conns [i]->fd < 0) {
+                        conns [i] = std::move (conns.back ()) ;
+                        conns.pop_back () ;
+                    }
+                    else {
+                        ++i ;
+                    }
+                }
+                if (fds [1].revents & POLLIN) {
+                    while (true) {
+                        const int   fd = ::accept4 (listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC) ;
+                        if (fd < 0) {
+                            break ;
+                        }
+                        conns.emplace_back (new connection_t { fd, {}, {}, 0 }) ;
+                    }
+                }
+            }
+            for (const auto &c : conns) {
+                ::close (c->fd) ;
+            }
+            char    buf [64] ;
+            while (0 < ::read (wake_ [0], buf, sizeof (buf))) {
+                /* Drains the wakeups */
+            }
+        }
+
+        /// Makes `serve` return (callable from any thread or a signal handler).
+        void    stop () {
+            const char  c = 0 ;
+            (void)::write (wake_ [1], &c, 1) ;
+        }
+
+        /// # of streams handed out so far.
+        uint64_t    issued () const {
+            return issued_.load (std::memory_order_relaxed) ;
+        }
+
+        /// # of requests answered so far.
+        uint64_t    requests () const {
+            return requests_.load (std::memory_order_relaxed) ;
+        }
+    } ;
+
+    /**
+     * Connection to a `server`.
+     *
+     * `post` only queues a request, so any # of them can be in flight: Requests are sent by the
+     * next `flush` (or `wait`) and their responses are collected by `wait` in posting order.
+     * The server stops reading while `OUTPUT_HIGH_WATER` bytes of responses are unread, so the
+     * client keeps reading while it sends: `wait` reads no further than the response it returns,
+     * `flush` buffers whatever arrives until every queued request went out.
+     */
+    class client {
+        int     fd_ = -1 ;
+        std::vector<uint8_t>    out_ ;
+        size_t                  sent_ = 0 ;     // Bytes of `out_` already sent.
+        std::vector<uint8_t>    in_ ;
+        size_t                  consumed_ = 0 ; // Bytes of `in_` already returned by `wait`.
+        std::deque<uint64_t>    pending_ ;  // Tags of the requests in flight.
+        uint64_t    next_tag_ = 0 ;
+
+        size_t  buffered () const {
+            return in_.size () - consumed_ ;
+        }
+
+        static bool would_block (int err) {
+            return err == EAGAIN || err == EWOULDBLOCK || err == EINTR ;
+        }
+
+        /// Waits until the socket is ready, then sends what it takes and receives up to `want` bytes.
+        void    pump (size_t want) {
+            pollfd  p { fd_, static_cast<short> (POLLIN | (sent_ < out_.size () ? POLLOUT : 0)), 0 } ;
+            if (::poll (&p, 1, -1) < 0) {
+                if (errno == EINTR) {
+                    return ;
+                }
+                detail::fail_errno ("LeaseService::client") ;
+            }
+            if ((p.revents & POLLOUT) != 0) {
+                const ssize_t   r = ::send (fd_, out_.data () + sent_, out_.size () - sent_, MSG_NOSIGNAL | MSG_DONTWAIT) ;
+                if (r < 0 && ! would_block (errno)) {
+                    detail::fail_errno ("LeaseService::client") ;
+                }
+                if (0 < r) {
+                    sent_ += static_cast<size_t> (r) ;
+                    if (sent_ == out_.size ()) {
+                        out_.clear () ;
+                        sent_ = 0 ;
+                    }
+                }
+            }
+            if ((p.revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL)) != 0) {
+                if (consumed_ == in_.size ()) {
+                    in_.clear () ;
+                    consumed_ = 0 ;
+                }
+                const size_t    base = in_.size () ;
+                in_.resize (base + want) ;
+                const ssize_t   r = ::recv (fd_, in_.data () + base, want, MSG_DONTWAIT) ;
+                const int       err = errno ;
+                in_.resize (base + (0 < r ? static_cast<size_t> (r) : 0)) ;
+                if (r == 0 || (r < 0 && ! would_block (err))) {
+                    throw std::system_error { r < 0 ? err : ECONNRESET, std::generic_category (), "LeaseService::client" } ;
+                }
+            }
+        }
+
+        /// Keeps sending until `size` bytes of responses are buffered.
+        void    receive (size_t size) {
+            while (buffered () < size) {
+                pump (size - buffered ()) ;
+            }
+        }
+    public:
+        /// @throw std::system_error on errors.
+        explicit client (const std::string &path) {
+            const sockaddr_un   addr = detail::address_of (path) ;
+            fd_ = ::socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) ;
+            if (fd_ < 0) {
+                detail::fail_errno (path) ;
+            }
+            if (::connect (fd_, reinterpret_cast<const sockaddr *> (&addr), sizeof (addr)) != 0) {
+                const int   err = errno ;
+                ::close (fd_) ;
+                throw std::system_error { err, std::generic_category (), path } ;
+            }
+        }
+
+        client (const client &) = delete ;
+        client &    operator = (const client &) = delete ;
+
+        ~client () {
+            ::close (fd_) ;
+        }
+
+        /// Queues a request for `count` streams (1..MAX_STREAMS).
+        void    post (uint32_t count) {
+            const size_t    base = out_.size () ;
+            out_.resize (base + REQUEST_SIZE) ;
+            detail::store_le (out_.data () + base, detail::REQUEST_MAGIC, 4) ;
+            detail::store_le (out_.data () + base + 4, count, 4) ;
+            detail::store_le (out_.data () + base + 8, next_tag_, 8) ;
+            pending_.push_back (next_tag_++) ;
+        }
+
+        /// Sends the queued requests (responses arriving meanwhile are buffered for `wait`).
+        void    flush () {
+            while (sent_ < out_.size ()) {
+                pump (64u << 10) ;
+            }
+        }
+
+        /// # of requests in flight.
+        size_t  pending () const {
+            return pending_.size () ;
+        }
+
+        /**
+         * Streams of the oldest request in flight.
+         * @param index Receives the server's index of the first stream (if not null).
+         * @throw std::system_error on errors, with `std::errc::protocol_error` for malformed or refused requests.
+         */
+        std::vector<state_t>    wait (uint64_t *index = nullptr) {
+            if (pending_.empty ()) {
+                throw std::system_error { std::make_error_code (std::errc::operation_not_permitted), "LeaseService::client: Nothing to wait for" } ;
+            }
+            receive (RESPONSE_HEADER_SIZE) ;
+            const uint64_t  tag = pending_.front () ;
+            pending_.pop_front () ;
+            const uint8_t * header = in_.data () + consumed_ ;
+            const uint32_t  count = static_cast<uint32_t> (detail::load_le (header + 8, 4)) ;
+            if (detail::load_le (header, 4) != detail::RESPONSE_MAGIC
+                || detail::load_le (header + 16, 8) != tag
+                || MAX_STREAMS < count) {
+                throw std::system_error { std::make_error_code (std::errc::protocol_error), "LeaseService::client" } ;
+            }
+            const size_t    size = RESPONSE_HEADER_SIZE + count * sizeof (state_t) ;
+            receive (size) ;
+            header = in_.data () + consumed_ ;
+            consumed_ += size ;
+            if (detail::load_le (header + 4, 4) != static_cast<uint32_t> (status_t::ok)) {
+                throw std::system_error { std::make_error_code (std::errc::protocol_error), "LeaseService::client: Request refused" } ;
+            }
+            const uint8_t * body = header + RESPONSE_HEADER_SIZE ;
+            std::vector<state_t>    result (count) ;
+            for (size_t i = 0 ; i < count ; ++i) {
+                result [i][0] = detail::load_le (body + 16 * i, 8) ;
+                result [i][1] = detail::load_le (body + 16 * i + 8, 8) ;
+            }
+            if (index != nullptr) {
+                *index = detail::load_le (header + 24, 8) ;
+            }
+            return result ;
+        }
+
+        /// One round trip for `count` streams.
+        std::vector<state_t>    take (uint32_t count = 1, uint64_t *index = nullptr) {
+            post (count) ;
+            return wait (index) ;
+        }
+    } ;
+}
+
+#endif /* lease_service_hpp__2B8E4D17_A6C3_4F09_9E52_D0713C6B8FA4 */
@@ -0,0 +1,236 @@
+/**
+ * numa_bank.hpp: Banks of per-thread generator states (and output buffers) placed on their users' NUMA nodes (Linux).
+ *
+ * Topology comes from libnuma when built with `XORSHIFT_LIBNUMA` (see CMakeLists.txt), from sysfs otherwise.
+ * Memory policies are set with the raw `mbind` / `get_mempolicy` system calls in both cases, and every
+ * call degrades to plain first-touch allocation on kernels without NUMA support.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef numa_bank_hpp__6E1B9D42_F37A_4C85_A0D6_28C9E5B71F03
+#define numa_bank_hpp__6E1B9D42_F37A_4C85_A0D6_28C9E5B71F03  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <array>
+#include <string>
+#include <system_error>
+
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#ifndef XORSHIFT_LIBNUMA
+#   define XORSHIFT_LIBNUMA 0
+#endif
+
+#if XORSHIFT_LIBNUMA
+#   include <numa.h>
+#endif
+
+#ifndef XORSHIFT_CACHE_LINE_SIZE
+#   define XORSHIFT_CACHE_LINE_SIZE    64
+#endif
+
+namespace Numa {
+
+    using state_t = std::array<uint64_t, 2> ;
+
+    namespace detail {
+        // <numaif.h> values (the header ships with libnuma).
+        const int       MPOL_BIND_ = 2 ;
+        const unsigned  MPOL_MF_MOVE_ = 1u << 1 ;
+        const unsigned  MPOL_F_NODE_ = 1u << 0 ;
+        const unsigned  MPOL_F_ADDR_ = 1u << 1 ;
+        const size_t    MAX_NODES = 1024 ;
+
+        inline long get_mempolicy (int *mode, unsigned long *mask, unsigned long maxnode, const void *addr, unsigned flags) {
+#if defined (SYS_get_mempolicy)
+            return ::syscall (SYS_get_mempolicy, mode, mask, maxnode, addr, flags) ;
+#else
+            errno = ENOSYS ;
+            return -1 ;
+#endif
+        }
+
+        inline long mbind (void *addr, size_t len, int mode, const unsigned long *mask, unsigned long maxnode, unsigned flags) {
+#if defined (SYS_mbind)
+            return ::syscall (SYS_mbind, addr, len, mode, mask, maxnode, flags) ;
+#else
+            errno = ENOSYS ;
+            return -1 ;
+#endif
+        }
+
+        /// Highest node # listed under `dir` as "nodeN" (-1: none).
+        inline int  max_node_in (const char *dir) {
+            int     result = -1 ;
+            DIR *   d = ::opendir (dir) ;
+            if (d == nullptr) {
+                return result ;
+            }
+            while (const dirent *e = ::readdir (d)) {
+                int n ;
+                if (sscanf (e->d_name, "node%d", &n) == 1) {
+                    result = std::max (result, n) ;
+                }
+            }
+            ::closedir (d) ;
+            return result ;
+        }
+    }
+
+    /// True when the kernel supports memory policies (otherwise placement is plain first-touch).
+    inline bool available () {
+        static const bool   result = [] {
+#if XORSHIFT_LIBNUMA
+            if (::numa_available () < 0) {
+                return false ;
+            }
+#endif
+            int mode ;
+            return detail::get_mempolicy (&mode, nullptr, 0, nullptr, 0) == 0 ;
+        } () ;
+        return result ;
+    }
+
+    /// # of nodes (at least 1).
+    inline size_t   node_count () {
+        static const size_t result = [] {
+#if XORSHIFT_LIBNUMA
+            if (0 <= ::numa_available ()) {
+                return static_cast<size_t> (::numa_max_node () + 1) ;
+            }
+#endif
+            return static_cast<size_t> (std::max (0, detail::max_node_in ("/sys/devices/system/node")) + 1) ;
+        } () ;
+        return result ;
+    }
+
+    /// Node of `cpu` (0 when unknown).
+    inline int  node_of_cpu (size_t cpu) {
+#if XORSHIFT_LIBNUMA
+        if (0 <= ::numa_available ()) {
+            return std::max (0, ::numa_node_of_cpu (static_cast<int> (cpu))) ;
+        }
+#endif
+        const std::string   dir = "/sys/devices/system/cpu/cpu" + std::to_string (cpu) ;
+        return std::max (0, detail::max_node_in (dir.c_str ())) ;
+    }
+
+    /// Node of the CPU the caller runs on (0 when unknown).
+    inline int  current_node () {
+#if defined (SYS_getcpu)
+        unsigned    cpu = 0 ;
+        unsigned    node = 0 ;
+        if (::syscall (SYS_getcpu, &cpu, &node, nullptr) == 0) {
+            return static_cast<int> (node) ;
+        }
+#endif
+        return 0 ;
+    }
+
+    /// Node the page holding `p` was allocated on (-1: unknown or not faulted in yet).
+    inline int  node_of_address (const void *p) {
+        int node = -1 ;
+        if (detail::get_mempolicy (&node, nullptr, 0, p, detail::MPOL_F_NODE_ | detail::MPOL_F_ADDR_) != 0) {
+            return -1 ;
+        }
+        return node ;
+    }
+
+    /**
+     * Restricts the pages of [p, p + size) to `node`, migrating the ones allocated already.
+     * @return false when the kernel refused (e.g. no NUMA support), the memory is left as is then.
+     */
+    inline bool bind_memory (void *p, size_t size, int node) {
+        if (node < 0 || static_cast<size_t> (node) >= detail::MAX_NODES || ! available ()) {
+            return false ;
+        }
+        unsigned long   mask [detail::MAX_NODES / (8 * sizeof (unsigned long))] = {} ;
+        mask [node / (8 * sizeof (unsigned long))] = 1ul << (node % (8 * sizeof (unsigned long))) ;
+        return detail::mbind (p, size, detail::MPOL_BIND_, mask, detail::MAX_NODES + 1, detail::MPOL_MF_MOVE_) == 0 ;
+    }
+
+    /// How `shard_bank::place` puts a shard on the caller's node.
+    enum class placement_t {
+        first_touch,    ///< The placing thread faults the pages in (the kernel's default local allocation).
+        bind,           ///< `mbind` to the caller's node first (also moves a shard placed elsewhere before).
+    } ;
+
+    /**
+     * `shards` page-aligned shards, each holding a state (in a cache line of its own) followed by
+     * `buffer_words` words of output buffer.
+     *
+     * Pages are reserved but not touched on construction: Each user thread calls `place` on its
+     * own shard, so the state and the buffer it writes to land on its local node.
+     */
+    class shard_bank {
+        uint8_t *   base_ = nullptr ;
+        size_t      shards_ ;
+        size_t      buffer_words_ ;
+        size_t      stride_ ;
+        placement_t placement_ ;
+
+        uint8_t *   shard (size_t i) const {
+            return base_ + i * stride_ ;
+        }
+    public:
+        /// @throw std::system_error when the memory cannot be reserved.
+        explicit shard_bank (size_t shards, size_t buffer_words = 0, placement_t placement = placement_t::first_touch)
+                : shards_ { shards }, buffer_words_ { buffer_words }, placement_ { placement } {
+            const size_t    page = static_cast<size_t> (::sysconf (_SC_PAGESIZE)) ;
+            stride_ = (XORSHIFT_CACHE_LINE_SIZE + buffer_words * sizeof (uint64_t) + page - 1) / page * page ;
+            void *  p = ::mmap (nullptr, std::max<size_t> (1, shards) * stride_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) ;
+            if (p == MAP_FAILED) {
+                throw std::system_error { errno, std::generic_category (), "Numa::shard_bank" } ;
+            }
+            base_ = static_cast<uint8_t *> (p) ;
+        }
+
+        shard_bank (const shard_bank &) = delete ;
+        shard_bank &    operator = (const shard_bank &) = delete ;
+
+        ~shard_bank () {
+            ::munmap (base_, std::max<size_t> (1, shards_) * stride_) ;
+        }
+
+        /**
+         * Puts the i-th shard on the caller's node and initializes it (the state with `initial`, the buffer with 0s).
+         * Call it from the thread that will use the shard.
+         */
+        state_t &   place (size_t i, const state_t &initial) {
+            if (placement_ == placement_t::bind) {
+                bind_memory (shard (i), stride_, current_node ()) ;
+            }
+            memset (shard (i), 0, stride_) ;
+            return state (i) = initial ;
+        }
+
+        state_t &   state (size_t i) const {
+            return *reinterpret_cast<state_t *> (shard (i)) ;
+        }
+
+        uint64_t *  buffer (size_t i) const {
+            return reinterpret_cast<uint64_t *> (shard (i) + XORSHIFT_CACHE_LINE_SIZE) ;
+        }
+
+        size_t  buffer_words () const { return buffer_words_ ; }
+        size_t  shards () const { return shards_ ; }
+        placement_t placement () const { return placement_ ; }
+
+        /// Node the i-th shard resides on (-1: unknown or not placed yet).
+        int     node_of (size_t i) const {
+            return node_of_address (shard (i)) ;
+        }
+    } ;
+}
+
+#endif /* numa_bank_hpp__6E1B9D42_F37A_4C85_A0D6_28C9E5B71F03 */
@@ -0,0 +1,328 @@
+/**
+ * persistent.hpp: Generators that never repeat a value across restarts, by durably leasing blocks of their stream (POSIX).
+ *
+ * Lease file layout (one page, all integers little-endian):
+ *
+ *      offset  size
+ *           0     8    magic "XSLEASE\x1A"
+ *           8     4    version (1)
+ *          12     4    reserved (0)
+ *          16     8    generator fingerprint
+ *          24    40    reserved (0)
+ *          64    32    record 0: sequence #, s[0], s[1], checksum
+ *         128    32    record 1
+ *
+ * Lease n is written to record (n % 2), so a torn write leaves the previous lease intact.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef persistent_hpp__9A3F6E21_0B7C_4D58_B2E9_64C1F8A05D37
+#define persistent_hpp__9A3F6E21_0B7C_4D58_B2E9_64C1F8A05D37  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.hpp"
+#include "engine.hpp"
+
+namespace Persistent {
+
+    using state_t = Engine::state_t ;
+
+    const uint32_t  VERSION = 1 ;
+    const size_t    FILE_SIZE = 4096 ;
+
+    namespace detail {
+        const uint8_t   MAGIC [8] = { 'X', 'S', 'L', 'E', 'A', 'S', 'E', 0x1A } ;
+        const size_t    RECORD_OFFSET = 64 ;
+        const size_t    RECORD_STRIDE = 64 ;
+
+        struct record_t {
+            uint64_t    sequence ;
+            state_t     state ;
+        } ;
+
+        inline uint64_t record_checksum (uint64_t fingerprint, const record_t &r) {
+            const Checkpoint::state_t   words [2] = { { r.sequence, fingerprint }, r.state } ;
+            return Checkpoint::checksum (words, 2) ;
+        }
+
+        /// Identifies the recurrence (its characteristic polynomial) and the scrambler.
+        template <typename Recurrence_, typename Scrambler_>
+            inline uint64_t fingerprint () {
+                unsigned    degree = 0 ;
+                const auto  P = Engine::detail::characteristic_polynomial<Recurrence_> (degree) ;
+                return P.w [0] ^ Engine::detail::rotl (P.w [1], 17) ^ Scrambler_::apply (0x9E3779B97F4A7C15ull, 0xBF58476D1CE4E5B9ull) ;
+            }
+
+        inline void fail (std::errc e, const std::string &path) {
+            throw std::system_error { std::make_error_code (e), path } ;
+        }
+    }
+
+    /**
+     * UniformRandomBitGenerator whose values are never handed out twice, even across crashes.
+     *
+     * The stream is leased in blocks of 2^log2_block steps: Before the first value of a block is
+     * returned, the state following the block is written to the lease file and flushed
+     * (`msync` + `fdatasync`).  A restarted generator resumes from the last durable lease,
+     * skipping whatever was left of the block in use (at most 2^log2_block values are lost).
+     * The file is locked (`flock`) while in use.  Single owner (no atomic ops).
+     */
+    template <typename Recurrence_, typename Scrambler_ = Engine::scrambler::plus>
+        class leased_engine {
+        public:
+            using core_type = Engine::core<Recurrence_, Scrambler_> ;
+            using result_type = uint64_t ;
+        private:
+            std::string     path_ ;
+            int             fd_ = -1 ;
+            uint8_t *       page_ = nullptr ;
+            uint64_t        fingerprint_ = detail::fingerprint<Recurrence_, Scrambler_> () ;
+            Engine::detail::gf2_poly    block_ ;
+            uint64_t        block_size_ ;
+            uint64_t        sequence_ = 0 ;     // # of the last durable lease.
+            uint64_t        remaining_ = 0 ;    // Values left in the current block.
+            state_t         state_ ;
+            bool            resumed_ = false ;
+
+            void    close () {
+                if (page_ != nullptr) {
+                    ::munmap (page_, FILE_SIZE) ;
+                    page_ = nullptr ;
+                }
+                if (0 <= fd_) {
+                    ::close (fd_) ;     // Releases the lock.
+                    fd_ = -1 ;
+                }
+            }
+
+            void    check (int r) {
+                if (r != 0) {
+                    const int   err = errno ;
+                    close () ;
+                    throw std::system_error { err, std::generic_category (), path_ } ;
+                }
+            }
+
+            uint8_t *   record_at (uint64_t sequence) const {
+                return page_ + detail::RECORD_OFFSET + (sequence % 2) * detail::RECORD_STRIDE ;
+            }
+
+            bool    read_record (size_t i, detail::record_t &r) const {
+                const uint8_t * p = record_at (i) ;
+                r.sequence = Checkpoint::detail::load_le (p, 8) ;
+                r.state [0] = Checkpoint::detail::load_le (p + 8, 8) ;
+                r.state [1] = Checkpoint::detail::load_le (p + 16, 8) ;
+                return Checkpoint::detail::load_le (p + 24, 8) == detail::record_checksum (fingerprint_, r) ;
+            }
+
+            /// Writes and flushes the record of lease `sequence` (the previous lease is left untouched).
+            void    write_record (uint64_t sequence, const state_t &state) {
+                const detail::record_t  r { sequence, state } ;
+                uint8_t *   p = record_at (sequence) ;
+                Checkpoint::detail::store_le (p, r.sequence, 8) ;
+                Checkpoint::detail::store_le (p + 8, r.state [0], 8) ;
+                Checkpoint::detail::store_le (p + 16, r.state [1], 8) ;
+                Checkpoint::detail::store_le (p + 24, detail::record_checksum (fingerprint_, r), 8) ;
+                if (::msync (page_, FILE_SIZE, MS_SYNC) != 0 || ::fdatasync (fd_) != 0) {
+                    throw std::system_error { errno, std::generic_category (), path_ } ;
+                }
+            }
+
+            /// Takes the file lock and maps the page (the file should be FILE_SIZE bytes).
+            void    lock_and_map () {
+                if (::flock (fd_, LOCK_EX | LOCK_NB) != 0) {
+                    const int   err = errno ;
+                    close () ;
+                    if (err == EWOULDBLOCK) {
+                        detail::fail (std::errc::device_or_resource_busy, path_) ;
+                    }
+                    throw std::system_error { err, std::generic_category (), path_ } ;
+                }
+                struct stat st ;
+                check (::fstat (fd_, &st)) ;
+                if (static_cast<uint64_t> (st.st_size) != FILE_SIZE) {
+                    close () ;
+                    detail::fail (std::errc::invalid_argument, path_) ;
+                }
+                void *  p = ::mmap (nullptr, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0) ;
+                if (p == MAP_FAILED) {
+                    check (-1) ;
+                }
+                page_ = static_cast<uint8_t *> (p) ;
+            }
+
+            /**
+             * Builds a new lease file under a temporary name and links it to `path_` once the header
+             * and record 0 are durable, so a crash never leaves a half-built file behind.
+             * @return false when another process created `path_` first (nothing is kept open then).
+             */
+            bool    create (const state_t &seed) {
+                static std::atomic<unsigned>    serial { 0 } ;
+                const std::string   tmp = path_ + ".tmp." + std::to_string (::getpid ()) + "." + std::to_string (serial++) ;
+                fd_ = ::open (tmp.c_str (), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644) ;
+                if (fd_ < 0) {
+                    throw std::system_error { errno, std::generic_category (), tmp } ;
+                }
+                try {
+                    check (::ftruncate (fd_, static_cast<off_t> (FILE_SIZE))) ;
+                    lock_and_map () ;
+                    memset (page_, 0, FILE_SIZE) ;
+                    memcpy (page_, detail::MAGIC, sizeof (detail::MAGIC)) ;
+                    Checkpoint::detail::store_le (page_ + 8, VERSION, 4) ;
+                    Checkpoint::detail::store_le (page_ + 16, fingerprint_, 8) ;
+                    write_record (0, seed) ;
+                    // link (unlike rename) never replaces a file another process created meanwhile.
+                    if (::link (tmp.c_str (), path_.c_str ()) != 0) {
+                        const int   err = errno ;
+                        close () ;
+                        ::unlink (tmp.c_str ()) ;
+                        if (err == EEXIST) {
+                            return false ;
+                        }
+                        throw std::system_error { err, std::generic_category (), path_ } ;
+                    }
+                    ::unlink (tmp.c_str ()) ;
+                    // Makes the new name durable too.
+                    Checkpoint::detail::sync_parent_directory (path_) ;
+                }
+                catch (...) {
+                    close () ;
+                    ::unlink (tmp.c_str ()) ;
+                    throw ;
+                }
+                sequence_ = 0 ;
+                state_ = seed ;
+                return true ;
+            }
+
+            void    resume () {
+                if (memcmp (page_, detail::MAGIC, sizeof (detail::MAGIC)) != 0
+                    || Checkpoint::detail::load_le (page_ + 8, 4) != VERSION
+                    || Checkpoint::detail::load_le (page_ + 16, 8) != fingerprint_) {
+                    detail::fail (std::errc::invalid_argument, path_) ;
+                }
+                detail::record_t    R [2] ;
+                const bool  valid [2] = { read_record (0, R [0]), read_record (1, R [1]) } ;
+                if (! valid [0] && ! valid [1]) {
+                    detail::fail (std::errc::illegal_byte_sequence, path_) ;
+                }
+                const size_t    i = ! valid [1] || (valid [0] && R [1].sequence < R [0].sequence) ? 0 : 1 ;
+                sequence_ = R [i].sequence ;
+                state_ = R [i].state ;
+                resumed_ = true ;
+            }
+
+            /// Durably leases the block starting at `state_`.
+            void    lease () {
+                state_t end = state_ ;
+                Engine::detail::apply_polynomial<Recurrence_> (block_, end) ;
+                write_record (sequence_ + 1, end) ;
+                ++sequence_ ;
+                remaining_ = block_size_ ;
+            }
+        public:
+            /**
+             * Opens (or creates, starting from `seed`) the lease file `path`.
+             * A new file only appears under `path` once its first lease is durable.
+             *
+             * @param log2_block    Block size (1..63): Larger blocks mean fewer flushes and more values skipped after a crash.
+             * @throw std::system_error on I/O errors, with `std::errc::invalid_argument` for files of other generators
+             *        (or a bad `log2_block`), `std::errc::illegal_byte_sequence` when both records are corrupt and
+             *        `std::errc::device_or_resource_busy` when another generator holds the file.
+             */
+            leased_engine (const std::string &path, const state_t &seed, unsigned log2_block = 24)
+                    : path_ { path }
+                    , block_ (Engine::detail::jump_polynomial<Recurrence_> (log2_block))
+                    , block_size_ { 1ull << (log2_block % 64) } {
+                if (log2_block == 0 || 64 <= log2_block) {
+                    detail::fail (std::errc::invalid_argument, path) ;
+                }
+                for (;;) {
+                    fd_ = ::open (path.c_str (), O_RDWR | O_CLOEXEC) ;
+                    if (0 <= fd_) {
+                        break ;
+                    }
+                    if (errno != ENOENT) {
+                        throw std::system_error { errno, std::generic_category (), path } ;
+                    }
+                    if (create (seed)) {
+                        return ;
+                    }
+                    // Another process created the file first: Resumes from theirs.
+                }
+                lock_and_map () ;
+                try {
+                    resume () ;
+                }
+                catch (...) {
+                    close () ;
+                    throw ;
+                }
+            }
+
+            leased_engine (const leased_engine &) = delete ;
+            leased_engine & operator = (const leased_engine &) = delete ;
+
+            ~leased_engine () {
+                close () ;
+            }
+
+            static constexpr result_type    min () { return 0 ; }
+            static constexpr result_type    max () { return std::numeric_limits<result_type>::max () ; }
+
+            result_type operator () () {
+                if (remaining_ == 0) {
+                    lease () ;
+                }
+                --remaining_ ;
+                return core_type::unsafe_next (state_) ;
+            }
+
+            /// Stores next `count` values into `out` (leasing as many blocks as needed).
+            void    fill (uint64_t *out, size_t count) {
+                while (0 < count) {
+                    if (remaining_ == 0) {
+                        lease () ;
+                    }
+                    const size_t    n = static_cast<size_t> (std::min<uint64_t> (remaining_, count)) ;
+                    core_type::unsafe_fill (state_, out, n) ;
+                    remaining_ -= n ;
+                    out += n ;
+                    count -= n ;
+                }
+            }
+
+            /// # of leases taken over the file's lifetime.
+            uint64_t    leases () const { return sequence_ ; }
+
+            /// Values left in the current block (handed out without touching the file).
+            uint64_t    remaining () const { return remaining_ ; }
+
+            /// True when the generator resumed from an existing file (the seed was ignored).
+            bool        resumed () const { return resumed_ ; }
+
+            const state_t & state () const { return state_ ; }
+        } ;
+
+    using leased_xorshift128_plus = leased_engine<Engine::recurrence::xorshift128<23, 18, 5>> ;
+    using leased_xoroshiro128_plus = leased_engine<Engine::recurrence::xoroshiro128<55, 14, 36>> ;
+}
+
+#endif /* persistent_hpp__9A3F6E21_0B7C_4D58_B2E9_64C1F8A05D37 */
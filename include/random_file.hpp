@@ -0,0 +1,143 @@
+/**
+ * random_file.hpp: Parallel, mmap backed materialization of random files (POSIX).
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef random_file_hpp__8B6D2E41_C3A7_4F95_9E10_2A7C5B8D3F64
+#define random_file_hpp__8B6D2E41_C3A7_4F95_9E10_2A7C5B8D3F64  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "xoroshiro.hpp"
+
+namespace XoRoShiRo {
+
+    struct materialize_options_t {
+        size_t  threads = 0 ;                   ///< # of filling threads (0: hardware concurrency).
+        size_t  region_size = 64u << 20 ;       ///< Bytes filled from one stream (multiple of 2MiB).
+        bool    huge_pages = true ;             ///< Advises transparent huge pages where supported.
+        bool    preallocate = true ;            ///< Reserves disk blocks up front (`posix_fallocate`).
+        bool    sync = false ;                  ///< Flushes every region to disk before unmapping it.
+    } ;
+
+    /**
+     * Creates (or overwrites) `path` with `size` random bytes.
+     *
+     * The file is split into `region_size` regions, the r-th region is filled from `root` jumped r times.
+     * Thus the content only depends on `root`, `size` and `region_size` (not on the # of threads).
+     *
+     * @throw std::system_error on I/O errors (the file is removed when the space cannot be reserved).
+     */
+    inline void materialize_file (const std::string &path, uint64_t size, const state_t &root, const materialize_options_t &opt = materialize_options_t {}) {
+        const size_t    REGION_ALIGN = 2u << 20 ;
+        if (opt.region_size == 0 || opt.region_size % REGION_ALIGN != 0) {
+            throw std::system_error { EINVAL, std::generic_category (), "materialize_file: region_size" } ;
+        }
+        const int   fd = ::open (path.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0644) ;
+        if (fd < 0) {
+            throw std::system_error { errno, std::generic_category (), path } ;
+        }
+        struct fd_closer {
+            int fd ;
+            ~fd_closer () { ::close (fd) ; }
+        } closer { fd } ;
+
+        if (::ftruncate (fd, static_cast<off_t> (size)) != 0) {
+            throw std::system_error { errno, std::generic_category (), path } ;
+        }
+        if (size == 0) {
+            return ;
+        }
+#if defined (__linux__)
+        if (opt.preallocate) {
+            // Some file systems do not support it, other errors (e.g. ENOSPC) would raise SIGBUS through the mapping.
+            const int   rc = ::posix_fallocate (fd, 0, static_cast<off_t> (size)) ;
+            if (rc != 0 && rc != EOPNOTSUPP && rc != EINVAL) {
+                ::unlink (path.c_str ()) ;
+                throw std::system_error { rc, std::generic_category (), path } ;
+            }
+        }
+#endif
+
+        const uint64_t  num_regions = (size + opt.region_size - 1) / opt.region_size ;
+        const size_t    num_threads = static_cast<size_t> (std::min<uint64_t> (num_regions, opt.threads != 0 ? opt.threads : std::max (1u, std::thread::hardware_concurrency ()))) ;
+
+        std::atomic<uint64_t>   next_region { 0 } ;
+        std::atomic<int>        error { 0 } ;
+
+        auto    worker = [&]() {
+            // Regions are claimed in increasing order, so the stream is advanced incrementally.
+            state_t     S = root ;
+            uint64_t    pos = 0 ;   // Region index `S` corresponds to.
+            while (error.load () == 0) {
+                const uint64_t  r = next_region.fetch_add (1) ;
+                if (num_regions <= r) {
+                    break ;
+                }
+                for ( ; pos < r ; ++pos) {
+                    unsafe_jump (S) ;
+                }
+                state_t         T = S ;
+                const uint64_t  offset = r * opt.region_size ;
+                const size_t    len = static_cast<size_t> (std::min<uint64_t> (opt.region_size, size - offset)) ;
+                void *  p = ::mmap (nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t> (offset)) ;
+                if (p == MAP_FAILED) {
+                    error.store (errno) ;
+                    break ;
+                }
+#if defined (MADV_SEQUENTIAL)
+                ::madvise (p, len, MADV_SEQUENTIAL) ;
+#endif
+#if defined (MADV_HUGEPAGE)
+                if (opt.huge_pages) {
+                    ::madvise (p, len, MADV_HUGEPAGE) ;
+                }
+#endif
+                auto *          out = static_cast<uint64_t *> (p) ;
+                const size_t    words = len / sizeof (uint64_t) ;
+                unsafe_fill (T, out, words) ;
+                if (const size_t tail = len % sizeof (uint64_t)) {
+                    const uint64_t  v = unsafe_next (T) ;
+                    ::memcpy (out + words, &v, tail) ;
+                }
+                if (opt.sync && ::msync (p, len, MS_SYNC) != 0) {
+                    error.store (errno) ;
+                }
+                ::munmap (p, len) ;
+            }
+        } ;
+
+        std::vector<std::thread>    threads ;
+        for (size_t i = 1 ; i < num_threads ; ++i) {
+            threads.emplace_back (worker) ;
+        }
+        worker () ;
+        for (auto &th : threads) {
+            th.join () ;
+        }
+        if (error.load () != 0) {
+            throw std::system_error { error.load (), std::generic_category (), path } ;
+        }
+        if (opt.sync && ::fsync (fd) != 0) {
+            throw std::system_error { errno, std::generic_category (), path } ;
+        }
+    }
+}
+
+#endif /* random_file_hpp__8B6D2E41_C3A7_4F95_9E10_2A7C5B8D3F64 */
@@ -0,0 +1,316 @@
+/**
+ * shared_state.hpp: Generator states shared between processes in POSIX shared memory (`shm_open` / `memfd_create`).
+ *
+ * Layout (native byte order, the region never leaves the host):
+ *
+ *      offset  size
+ *           0     8    magic "XSSHARE\x1A" (stored last, when the region is ready)
+ *           8     4    version (1)
+ *          12     4    generator kind (`Checkpoint::kind_t`)
+ *          16     8    # of shards
+ *          24     8    # of claimed shards
+ *          32    32    reserved (0)
+ *          64    64    root state (16 bytes, padded to a cache line)
+ *         128  64*N    shard states (16 bytes each, padded to a cache line)
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef shared_state_hpp__5C2E8A17_B43D_4E96_A0F1_7D6B9E2C8341
+#define shared_state_hpp__5C2E8A17_B43D_4E96_A0F1_7D6B9E2C8341  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include <atomic>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "checkpoint.hpp"
+#include "substream.hpp"
+#include "xorshift.hpp"
+#include "xoroshiro.hpp"
+
+#if XORSHIFT_LOCKFREE && XOROSHIRO_LOCKFREE
+
+namespace SharedState {
+
+    using state_t = Checkpoint::state_t ;
+    using kind_t = Checkpoint::kind_t ;
+
+    const uint32_t  VERSION = 1 ;
+    const size_t    SLOT_SIZE = 64 ;
+
+    static_assert (ATOMIC_LLONG_LOCK_FREE == 2, "Counters in shared memory should be lock-free (address free).") ;
+
+    namespace detail {
+        const uint64_t  MAGIC = 0x1A45524148535358ull ;     // "XSSHARE\x1A" on little-endian hosts
+
+        struct header_t {
+            std::atomic<uint64_t>   magic ;
+            uint32_t                version ;
+            uint32_t                kind ;
+            uint64_t                shards ;
+            std::atomic<uint64_t>   claimed ;
+            uint8_t                 reserved [32] ;
+        } ;
+
+        static_assert (sizeof (header_t) == SLOT_SIZE, "Header should fill a cache line.") ;
+
+        inline size_t   region_size (uint64_t shards) {
+            return static_cast<size_t> ((2 + shards) * SLOT_SIZE) ;
+        }
+
+        inline void fail (std::errc e, const std::string &what) {
+            throw std::system_error { std::make_error_code (e), what } ;
+        }
+    }
+
+    /**
+     * A root state (and optionally `shards` per-process states) in a shared memory region.
+     *
+     * Every state lives in a cache line of its own and is updated in place with the lock-free
+     * (CMPXCHG16B) `next` / `jump`, so drawing costs one compare & swap and no system calls.
+     * Shard i starts from the creator's `root` jumped i times, and the root stream follows the
+     * last shard: Every stream is reproducible from `root` and `shards` alone, and neither
+     * jumping nor splitting the root ever runs into a shard.
+     */
+    class region {
+        void *      base_ = nullptr ;
+        size_t      length_ = 0 ;
+        int         fd_ = -1 ;
+
+        region (int fd, const std::string &what) : fd_ { fd } {
+            if (fd < 0) {
+                throw std::system_error { errno, std::generic_category (), what } ;
+            }
+        }
+
+        detail::header_t &  header () const {
+            return *static_cast<detail::header_t *> (base_) ;
+        }
+
+        state_t &   slot (size_t i) const {
+            return *reinterpret_cast<state_t *> (static_cast<uint8_t *> (base_) + (1 + i) * SLOT_SIZE) ;
+        }
+
+        void    map (size_t length, const std::string &what) {
+            void *  p = ::mmap (nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0) ;
+            if (p == MAP_FAILED) {
+                throw std::system_error { errno, std::generic_category (), what } ;
+            }
+            base_ = p ;
+            length_ = length ;
+        }
+
+        void    initialize (kind_t kind, const state_t &root, size_t shards, const std::string &what) {
+            const size_t    length = detail::region_size (shards) ;
+            if (::ftruncate (fd_, static_cast<off_t> (length)) != 0) {
+                throw std::system_error { errno, std::generic_category (), what } ;
+            }
+            map (length, what) ;
+            auto &  H = header () ;
+            H.version = VERSION ;
+            H.kind = static_cast<uint32_t> (kind) ;
+            H.shards = shards ;
+            H.claimed.store (0, std::memory_order_relaxed) ;
+            state_t S = root ;
+            for (size_t i = 0 ; i < shards ; ++i) {
+                shard (i) = S ;
+                jump_of (kind).apply (S, S) ;
+            }
+            state () = S ;
+            // Attachers only trust a region once the magic is in place.
+            H.magic.store (detail::MAGIC, std::memory_order_release) ;
+        }
+
+        void    validate (kind_t expected, const std::string &what) {
+            struct stat st ;
+            if (::fstat (fd_, &st) != 0) {
+                throw std::system_error { errno, std::generic_category (), what } ;
+            }
+            if (static_cast<uint64_t> (st.st_size) < detail::region_size (0)) {
+                detail::fail (std::errc::invalid_argument, what) ;
+            }
+            map (static_cast<size_t> (st.st_size), what) ;
+            const auto &    H = header () ;
+            if (H.magic.load (std::memory_order_acquire) != detail::MAGIC
+                || H.version != VERSION
+                || H.kind != static_cast<uint32_t> (expected)
+                || (static_cast<uint64_t> (st.st_size) - detail::region_size (0)) / SLOT_SIZE != H.shards) {
+                detail::fail (std::errc::invalid_argument, what) ;
+            }
+        }
+
+        static const Substream::jump_table_t &  jump_of (kind_t kind) {
+            return kind == kind_t::xorshift128_plus ? XorShift::jump_table () : XoRoShiRo::jump_table () ;
+        }
+    public:
+        region () = default ;
+
+        region (region &&other) noexcept : base_ { other.base_ }, length_ { other.length_ }, fd_ { other.fd_ } {
+            other.base_ = nullptr ;
+            other.length_ = 0 ;
+            other.fd_ = -1 ;
+        }
+
+        region &    operator = (region &&other) noexcept {
+            if (this != &other) {
+                this->~region () ;
+                new (this) region { std::move (other) } ;
+            }
+            return *this ;
+        }
+
+        region (const region &) = delete ;
+        region &    operator = (const region &) = delete ;
+
+        ~region () {
+            if (base_ != nullptr) {
+                ::munmap (base_, length_) ;
+            }
+            if (0 <= fd_) {
+                ::close (fd_) ;
+            }
+        }
+
+        /**
+         * Creates the named region `name` (e.g. "/myapp-rng", fails if it exists already).
+         * @throw std::system_error on errors.
+         */
+        static region   create (const std::string &name, kind_t kind, const state_t &root, size_t shards = 0) {
+            region  result { ::shm_open (name.c_str (), O_RDWR | O_CREAT | O_EXCL, 0600), name } ;
+            try {
+                result.initialize (kind, root, shards, name) ;
+            }
+            catch (...) {
+                ::shm_unlink (name.c_str ()) ;
+                throw ;
+            }
+            return result ;
+        }
+
+        /**
+         * Attaches to the named region `name`.
+         * @throw std::system_error on errors, with `std::errc::invalid_argument` for malformed (or not yet
+         *        initialized) regions and regions of another generator.
+         */
+        static region   open (const std::string &name, kind_t expected) {
+            region  result { ::shm_open (name.c_str (), O_RDWR, 0), name } ;
+            result.validate (expected, name) ;
+            return result ;
+        }
+
+        /// Removes the name `name` (attached processes keep their mappings).
+        static void     unlink (const std::string &name) {
+            if (::shm_unlink (name.c_str ()) != 0) {
+                throw std::system_error { errno, std::generic_category (), name } ;
+            }
+        }
+
+        /**
+         * Creates an unnamed region: Shared with children by `fork`, or with other processes by passing `fd ()`
+         * (e.g. with `SCM_RIGHTS`) to `attach`.
+         */
+        static region   anonymous (kind_t kind, const state_t &root, size_t shards = 0) {
+#if defined (__linux__) && defined (MFD_CLOEXEC)
+            region  result { ::memfd_create ("xorshift-shared-state", MFD_CLOEXEC), "memfd_create" } ;
+#else
+            const std::string   name = "/xorshift-shared-state-" + std::to_string (::getpid ()) ;
+            region  result { ::shm_open (name.c_str (), O_RDWR | O_CREAT | O_EXCL, 0600), name } ;
+            ::shm_unlink (name.c_str ()) ;
+#endif
+            result.initialize (kind, root, shards, "anonymous") ;
+            return result ;
+        }
+
+        /// Attaches to the region behind `fd` (the descriptor is duplicated, the caller keeps `fd`).
+        static region   attach (int fd, kind_t expected) {
+            region  result { ::fcntl (fd, F_DUPFD_CLOEXEC, 0), "attach" } ;
+            result.validate (expected, "attach") ;
+            return result ;
+        }
+
+        int     fd () const { return fd_ ; }
+
+        kind_t  kind () const {
+            return static_cast<kind_t> (header ().kind) ;
+        }
+
+        /// The root state (aligned to 16 bytes, updated with the lock-free functions only).
+        state_t &   state () const {
+            return slot (0) ;
+        }
+
+        size_t  shards () const {
+            return static_cast<size_t> (header ().shards) ;
+        }
+
+        /**
+         * The i-th shard state.
+         * @throw std::out_of_range when `shards () <= i`.
+         */
+        state_t &   shard (size_t i) const {
+            if (header ().shards <= i) {
+                throw std::out_of_range { "shard" } ;
+            }
+            return slot (1 + i) ;
+        }
+
+        /**
+         * Reserves a shard for the calling process (one atomic increment).
+         * @throw std::system_error with `std::errc::no_buffer_space` when every shard was claimed.
+         */
+        size_t  claim_shard () {
+            const uint64_t  i = header ().claimed.fetch_add (1) ;
+            if (header ().shards <= i) {
+                detail::fail (std::errc::no_buffer_space, "claim_shard") ;
+            }
+            return static_cast<size_t> (i) ;
+        }
+
+        /// Draws the next value from the root stream.
+        uint64_t    next () {
+            return next (state ()) ;
+        }
+
+        /// Draws the next value from the i-th shard (`std::out_of_range` when `shards () <= i`).
+        uint64_t    next_shard (size_t i) {
+            return next (shard (i)) ;
+        }
+
+        /// Jumps the root stream.
+        void    jump () {
+            if (kind () == kind_t::xorshift128_plus) {
+                XorShift::jump (state ()) ;
+            }
+            else {
+                XoRoShiRo::jump (state ()) ;
+            }
+        }
+
+#if CONTENTION_AVAILABLE
+        /// Splits a private child stream off the root (see `take_stream`).
+        state_t take_stream () {
+            return kind () == kind_t::xorshift128_plus ? XorShift::take_stream (state ()) : XoRoShiRo::take_stream (state ()) ;
+        }
+#endif
+    private:
+        uint64_t    next (state_t &S) const {
+            return kind () == kind_t::xorshift128_plus ? XorShift::next (S) : XoRoShiRo::next (S) ;
+        }
+    } ;
+}
+
+#endif  /* XORSHIFT_LOCKFREE && XOROSHIRO_LOCKFREE */
+
+#endif /* shared_state_hpp__5C2E8A17_B43D_4E96_A0F1_7D6B9E2C8341 */
@@ -0,0 +1,228 @@
+/**
+ * state_bank.hpp: Many independent xoroshiro128+ streams in structure-of-arrays layout, stepped in SIMD passes.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef state_bank_hpp__8D4A1F63_2C9B_4E07_B5A8_F3160E7D29C4
+#define state_bank_hpp__8D4A1F63_2C9B_4E07_B5A8_F3160E7D29C4  1
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <new>
+
+#include "substream.hpp"
+#include "xoroshiro.hpp"
+
+#if defined (__AVX2__)
+#   include <immintrin.h>
+#endif
+
+/**
+ * Explicit AVX2 kernels (4 streams per instruction) when compiled for AVX2 (e.g. `-mavx2`, `-march=native`).
+ * Otherwise the plain loops are left to the auto-vectorizer.
+ */
+#ifndef XOROSHIRO_BANK_AVX2
+#   if defined (__AVX2__)
+#       define XOROSHIRO_BANK_AVX2  1
+#   else
+#       define XOROSHIRO_BANK_AVX2  0
+#   endif
+#endif
+
+namespace XoRoShiRo {
+
+    /**
+     * `size` streams, stored as two aligned arrays (s0 [] and s1 []) instead of an array of `state_t`.
+     *
+     * Every bulk operation is a streaming pass over both arrays.  Thread agnostic (like `unsafe_next`):
+     * Disjoint index sets may be processed by different threads.
+     */
+    class state_bank {
+    public:
+        using index_t = uint32_t ;
+        static constexpr size_t ALIGNMENT = 64 ;
+    private:
+        struct free_deleter {
+            void    operator () (uint64_t *p) const { ::free (p) ; }
+        } ;
+        using array_t = std::unique_ptr<uint64_t [], free_deleter> ;
+
+        size_t  size_ ;
+        array_t s0_ ;
+        array_t s1_ ;
+
+        static array_t  allocate (size_t n) {
+            void *  p = nullptr ;
+            const size_t    bytes = (n * sizeof (uint64_t) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT ;
+            if (::posix_memalign (&p, ALIGNMENT, bytes == 0 ? ALIGNMENT : bytes) != 0) {
+                throw std::bad_alloc {} ;
+            }
+            return array_t { static_cast<uint64_t *> (p) } ;
+        }
+
+        /// One step of stream i (stored back), returns its output.
+        uint64_t    step (size_t i) {
+            state_t S { s0_ [i], s1_ [i] } ;
+            const uint64_t  result = unsafe_next (S) ;
+            s0_ [i] = S [0] ;
+            s1_ [i] = S [1] ;
+            return result ;
+        }
+
+#if XOROSHIRO_BANK_AVX2
+        template <int K_>
+            static __m256i  rotl (__m256i v) {
+                return _mm256_or_si256 (_mm256_slli_epi64 (v, K_), _mm256_srli_epi64 (v, 64 - K_)) ;
+            }
+
+        /// 4 lanes of `unsafe_next`.
+        static __m256i  step (__m256i &s0, __m256i &s1) {
+            const __m256i   result = _mm256_add_epi64 (s0, s1) ;
+            const __m256i   t = _mm256_xor_si256 (s1, s0) ;
+            s0 = _mm256_xor_si256 (_mm256_xor_si256 (rotl<55> (s0), t), _mm256_slli_epi64 (t, 14)) ;
+            s1 = rotl<36> (t) ;
+            return result ;
+        }
+#endif
+    public:
+        /// All streams zero (assign them with `set` before use).
+        explicit state_bank (size_t size) : size_ { size }, s0_ { allocate (size) }, s1_ { allocate (size) } {
+            for (size_t i = 0 ; i < size ; ++i) {
+                s0_ [i] = s1_ [i] = 0 ;
+            }
+        }
+
+        /// Stream i starts from `root` jumped i times (`jump_table`: 16 lookups per stream).
+        state_bank (size_t size, const state_t &root) : state_bank (size) {
+            const auto &    J = jump_table () ;
+            state_t S = root ;
+            for (size_t i = 0 ; i < size ; ++i) {
+                s0_ [i] = S [0] ;
+                s1_ [i] = S [1] ;
+                J.apply (S, S) ;
+            }
+        }
+
+        size_t  size () const { return size_ ; }
+
+        uint64_t *          s0 () { return s0_.get () ; }
+        uint64_t *          s1 () { return s1_.get () ; }
+        const uint64_t *    s0 () const { return s0_.get () ; }
+        const uint64_t *    s1 () const { return s1_.get () ; }
+
+        state_t get (size_t i) const {
+            return state_t { s0_ [i], s1_ [i] } ;
+        }
+
+        void    set (size_t i, const state_t &state) {
+            s0_ [i] = state [0] ;
+            s1_ [i] = state [1] ;
+        }
+
+        /// Advances every stream by `steps` (discarding the outputs, each vector of streams stays in registers).
+        void    advance_all (size_t steps = 1) {
+            uint64_t * __restrict   a = s0_.get () ;
+            uint64_t * __restrict   b = s1_.get () ;
+            const size_t    n = size_ ;     // Not reloaded after each store (lets the loops vectorize).
+            size_t  i = 0 ;
+#if XOROSHIRO_BANK_AVX2
+            for ( ; i + 4 <= n ; i += 4) {
+                __m256i s0 = _mm256_load_si256 (reinterpret_cast<const __m256i *> (a + i)) ;
+                __m256i s1 = _mm256_load_si256 (reinterpret_cast<const __m256i *> (b + i)) ;
+                for (size_t k = 0 ; k < steps ; ++k) {
+                    step (s0, s1) ;
+                }
+                _mm256_store_si256 (reinterpret_cast<__m256i *> (a + i), s0) ;
+                _mm256_store_si256 (reinterpret_cast<__m256i *> (b + i), s1) ;
+            }
+#endif
+            for ( ; i < n ; ++i) {
+                uint64_t    s0 = a [i] ;
+                uint64_t    s1 = b [i] ;
+                for (size_t k = 0 ; k < steps ; ++k) {
+                    s1 ^= s0 ;
+                    s0 = detail::rotl (s0, 55) ^ s1 ^ (s1 << 14) ;
+                    s1 = detail::rotl (s1, 36) ;
+                }
+                a [i] = s0 ;
+                b [i] = s1 ;
+            }
+        }
+
+        /// out [i] = next value of stream i, for every stream.
+        void    next_all (uint64_t *out) {
+            uint64_t * __restrict   a = s0_.get () ;
+            uint64_t * __restrict   b = s1_.get () ;
+            uint64_t * __restrict   o = out ;
+            const size_t    n = size_ ;
+            size_t  i = 0 ;
+#if XOROSHIRO_BANK_AVX2
+            for ( ; i + 4 <= n ; i += 4) {
+                __m256i s0 = _mm256_load_si256 (reinterpret_cast<const __m256i *> (a + i)) ;
+                __m256i s1 = _mm256_load_si256 (reinterpret_cast<const __m256i *> (b + i)) ;
+                _mm256_storeu_si256 (reinterpret_cast<__m256i *> (o + i), step (s0, s1)) ;
+                _mm256_store_si256 (reinterpret_cast<__m256i *> (a + i), s0) ;
+                _mm256_store_si256 (reinterpret_cast<__m256i *> (b + i), s1) ;
+            }
+#endif
+            for ( ; i < n ; ++i) {
+                const uint64_t  s0 = a [i] ;
+                uint64_t        s1 = b [i] ;
+                o [i] = s0 + s1 ;
+                s1 ^= s0 ;
+                a [i] = detail::rotl (s0, 55) ^ s1 ^ (s1 << 14) ;
+                b [i] = detail::rotl (s1, 36) ;
+            }
+        }
+
+        /**
+         * out [k] = next value of stream indices [k] (k < count), the other streams are left as is.
+         * The indices should be distinct (and below 2^31).
+         */
+        void    next_masked (const index_t *indices, size_t count, uint64_t *out) {
+            size_t  k = 0 ;
+#if XOROSHIRO_BANK_AVX2
+            const auto *    a = reinterpret_cast<const long long *> (s0_.get ()) ;
+            const auto *    b = reinterpret_cast<const long long *> (s1_.get ()) ;
+            for ( ; k + 4 <= count ; k += 4) {
+                const __m128i   idx = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (indices + k)) ;
+                __m256i s0 = _mm256_i32gather_epi64 (a, idx, 8) ;
+                __m256i s1 = _mm256_i32gather_epi64 (b, idx, 8) ;
+                _mm256_storeu_si256 (reinterpret_cast<__m256i *> (out + k), step (s0, s1)) ;
+                // No scatter in AVX2.
+                alignas (32) uint64_t   t0 [4] ;
+                alignas (32) uint64_t   t1 [4] ;
+                _mm256_store_si256 (reinterpret_cast<__m256i *> (t0), s0) ;
+                _mm256_store_si256 (reinterpret_cast<__m256i *> (t1), s1) ;
+                for (int j = 0 ; j < 4 ; ++j) {
+                    s0_ [indices [k + j]] = t0 [j] ;
+                    s1_ [indices [k + j]] = t1 [j] ;
+                }
+            }
+#endif
+            for ( ; k < count ; ++k) {
+                out [k] = step (indices [k]) ;
+            }
+        }
+
+        /// out [k] = state of stream indices [k] (e.g. to hand a subset over to scalar code).
+        void    gather (const index_t *indices, size_t count, state_t *out) const {
+            for (size_t k = 0 ; k < count ; ++k) {
+                out [k] = get (indices [k]) ;
+            }
+        }
+
+        /// Stores in [k] as the state of stream indices [k] (the inverse of `gather`).
+        void    scatter (const index_t *indices, size_t count, const state_t *in) {
+            for (size_t k = 0 ; k < count ; ++k) {
+                set (indices [k], in [k]) ;
+            }
+        }
+    } ;
+}
+
+#endif /* state_bank_hpp__8D4A1F63_2C9B_4E07_B5A8_F3160E7D29C4 */
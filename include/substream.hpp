@@ -0,0 +1,120 @@
+/**
+ * substream.hpp: Splits private child streams off a shared state with a single compare & swap.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef substream_hpp__3F0C6A52_9D1E_4B7A_8E24_C15D7B93A06E
+#define substream_hpp__3F0C6A52_9D1E_4B7A_8E24_C15D7B93A06E  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <array>
+
+#include "contention.hpp"
+#include "xorshift.hpp"
+#include "xoroshiro.hpp"
+
+namespace Substream {
+
+    /**
+     * `jump` as a GF(2) linear map over the 128 bit state, tabulated per byte:
+     * `images_ [k][v]` is the jumped image of the state whose k-th byte is `v` (and the rest zero).
+     * Jumping a state is 16 lookups and xors instead of 128 generator steps (the table takes 64KiB).
+     */
+    class jump_table_t {
+    public:
+        using state_t = std::array<uint64_t, 2> ;
+    private:
+        state_t images_ [16][256] ;
+    public:
+        /// @param jump  The generator's `unsafe_jump`.
+        template <typename JUMP_>
+            explicit jump_table_t (JUMP_ jump) {
+                for (size_t k = 0 ; k < 16 ; ++k) {
+                    images_ [k][0] = state_t { 0, 0 } ;
+                    for (int b = 0 ; b < 8 ; ++b) {
+                        state_t S { 0, 0 } ;
+                        S [k / 8] = 1ull << (8 * (k % 8) + b) ;
+                        jump (S) ;
+                        // Extends the images of values below 2^b by the image of bit b.
+                        const size_t    hi = size_t { 1 } << b ;
+                        for (size_t v = 0 ; v < hi ; ++v) {
+                            images_ [k][hi + v] = state_t { images_ [k][v][0] ^ S [0], images_ [k][v][1] ^ S [1] } ;
+                        }
+                    }
+                }
+            }
+
+        jump_table_t (const jump_table_t &) = delete ;
+        jump_table_t &  operator = (const jump_table_t &) = delete ;
+
+        /// Stores `state` jumped into `result` (may alias `state`).
+        void    apply (const state_t &state, state_t &result) const {
+            uint64_t    s0 = 0 ;
+            uint64_t    s1 = 0 ;
+            for (size_t k = 0 ; k < 16 ; ++k) {
+                const auto &    I = images_ [k][(state [k / 8] >> (8 * (k % 8))) & 0xFFu] ;
+                s0 ^= I [0] ;
+                s1 ^= I [1] ;
+            }
+            result [0] = s0 ;
+            result [1] = s1 ;
+        }
+    } ;
+
+#if CONTENTION_AVAILABLE
+
+    namespace detail {
+        inline std::array<uint64_t, 2>  take (std::array<uint64_t, 2> &shared, const jump_table_t &table, const Contention::backoff_t &backoff) {
+            std::array<uint64_t, 2> child ;
+            Contention::detail::update (shared, backoff, [&table, &child](const std::array<uint64_t, 2> &S, std::array<uint64_t, 2> &D) -> uint64_t {
+                child = S ;
+                table.apply (S, D) ;
+                return 0 ;
+            }) ;
+            return child ;
+        }
+    }
+
+#endif  /* CONTENTION_AVAILABLE */
+}
+
+namespace XorShift {
+    /// Tabulated `unsafe_jump` (built at first use).
+    inline const Substream::jump_table_t &  jump_table () {
+        static const Substream::jump_table_t    table { [](state_t &S) { unsafe_jump (S) ; } } ;
+        return table ;
+    }
+
+#if CONTENTION_AVAILABLE
+    /**
+     * Returns the current `shared` state as a private child stream and jumps `shared` past it, atomically.
+     * The jump is precomputed, so each attempt (and retry) is a table lookup plus a single compare & swap.
+     */
+    inline state_t  take_stream (state_t &shared, const Contention::backoff_t &backoff = Contention::backoff_t {}) {
+        return Substream::detail::take (shared, jump_table (), backoff) ;
+    }
+#endif
+}
+
+namespace XoRoShiRo {
+    /// Tabulated `unsafe_jump` (built at first use).
+    inline const Substream::jump_table_t &  jump_table () {
+        static const Substream::jump_table_t    table { [](state_t &S) { unsafe_jump (S) ; } } ;
+        return table ;
+    }
+
+#if CONTENTION_AVAILABLE
+    /**
+     * Returns the current `shared` state as a private child stream and jumps `shared` past it, atomically.
+     * The jump is precomputed, so each attempt (and retry) is a table lookup plus a single compare & swap.
+     */
+    inline state_t  take_stream (state_t &shared, const Contention::backoff_t &backoff = Contention::backoff_t {}) {
+        return Substream::detail::take (shared, jump_table (), backoff) ;
+    }
+#endif
+}
+
+#endif /* substream_hpp__3F0C6A52_9D1E_4B7A_8E24_C15D7B93A06E */
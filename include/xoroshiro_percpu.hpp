@@ -0,0 +1,220 @@
+/**
+ * xoroshiro_percpu.hpp: Per-CPU xoroshiro128+ generator updated in restartable sequences (Linux rseq).
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef xoroshiro_percpu_hpp__E61B0D3A_7C25_48F9_A4D0_93F2C81B5E67
+#define xoroshiro_percpu_hpp__E61B0D3A_7C25_48F9_A4D0_93F2C81B5E67  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "xoroshiro.hpp"
+
+#if defined (__linux__)
+#   include <sched.h>
+#   include <unistd.h>
+#endif
+
+/**
+ * Updates per-CPU states in rseq critical sections (glibc >= 2.35 registers every thread's `struct rseq`).
+ */
+#ifndef XOROSHIRO_RSEQ
+#   if defined (__linux__) && defined (__x86_64__) && defined (__GNUC__) && defined (__has_include)
+#       if __has_include (<sys/rseq.h>)
+#           include <sys/rseq.h>
+#           if defined (RSEQ_SIG)
+#               define XOROSHIRO_RSEQ   1
+#           endif
+#       endif
+#   endif
+#endif
+
+#ifndef XOROSHIRO_RSEQ
+#   define XOROSHIRO_RSEQ   0
+#endif
+
+#ifndef XORSHIFT_CACHE_LINE_SIZE
+#   define XORSHIFT_CACHE_LINE_SIZE    64
+#endif
+
+#if XOROSHIRO_LOCKFREE
+
+namespace XoRoShiRo {
+
+    /**
+     * One jump-separated stream per CPU.
+     *
+     * With rseq, `next` is plain loads and stores on the current CPU's slot: The next state is
+     * written to the inactive half of the slot and published by a single store of its index
+     * (the commit), so a preempted or migrated update is simply restarted.
+     * Without rseq (old kernels or glibc, other architectures) it falls back to
+     * `sched_getcpu` + the lock-free `next` on the slot.
+     */
+    class percpu_generator {
+    public:
+        struct alignas (XORSHIFT_CACHE_LINE_SIZE) slot_t {
+            uint64_t    active = 0 ;    ///< Index of the current state (rseq mode).
+            uint64_t    reserved = 0 ;
+            XOROSHIRO_ALIGNMENT state_t states [2] ;
+        } ;
+    private:
+        std::unique_ptr<slot_t []>  slots_ ;
+        size_t  count_ ;
+        slot_t  overflow_ ;     // Threads without rseq (or unexpected CPU #s) in rseq mode.
+        bool    rseq_ = false ;
+
+#if XOROSHIRO_RSEQ
+        static struct rseq *    rseq_area () {
+            return reinterpret_cast<struct rseq *> (static_cast<char *> (__builtin_thread_pointer ()) + __rseq_offset) ;
+        }
+
+        /// Returns false when the calling thread has no usable rseq area.
+        bool    rseq_next (uint64_t &result) {
+            struct rseq *   abi = rseq_area () ;
+            uint64_t    slot ;
+            uint64_t    idx ;
+            uint64_t    s0 ;
+            uint64_t    s1 ;
+            uint64_t    t ;
+            uint64_t    ok ;
+            __asm__ __volatile__ (".pushsection __rseq_cs, \"aw\"   \n"
+                                  ".balign 32                       \n"
+                                  "3:                               \n"
+                                  ".long 0, 0                       \n"     // version, flags
+                                  ".quad 1f, 2f - 1f, 4f            \n"     // start_ip, post_commit_offset, abort_ip
+                                  ".popsection                      \n"
+                                  "0:                               \n"
+                                  "leaq  3b(%%rip), %[slot]         \n"
+                                  "movq  %[slot], %[rseq_cs]        \n"
+                                  "1:                               \n"
+                                  "movl  %[cpu_id], %k[slot]        \n"
+                                  "cmpq  %[count], %[slot]          \n"
+                                  "jae   5f                         \n"
+                                  "imulq %[slot_size], %[slot], %[slot]  \n"
+                                  "addq  %[base], %[slot]           \n"
+                                  "movq  (%[slot]), %[idx]          \n"
+                                  "movq  %[idx], %[t]               \n"
+                                  "shlq  $4, %[t]                   \n"
+                                  "movq  16(%[slot], %[t]), %[s0]   \n"
+                                  "movq  24(%[slot], %[t]), %[s1]   \n"
+                                  "leaq  (%[s0], %[s1]), %[result]  \n"     // result = s0 + s1
+                                  "xorq  %[s0], %[s1]               \n"     // s1 ^= s0
+                                  "rolq  $55, %[s0]                 \n"
+                                  "xorq  %[s1], %[s0]               \n"
+                                  "movq  %[s1], %[t]                \n"
+                                  "shlq  $14, %[t]                  \n"
+                                  "xorq  %[t], %[s0]                \n"     // s0 = rotl (s0, 55) ^ s1 ^ (s1 << 14)
+                                  "rolq  $36, %[s1]                 \n"     // s1 = rotl (s1, 36)
+                                  "xorq  $1, %[idx]                 \n"
+                                  "movq  %[idx], %[t]               \n"
+                                  "shlq  $4, %[t]                   \n"
+                                  "movq  %[s0], 16(%[slot], %[t])   \n"
+                                  "movq  %[s1], 24(%[slot], %[t])   \n"
+                                  "movq  %[idx], (%[slot])          \n"     // Commit
+                                  "2:                               \n"
+                                  ".pushsection __rseq_failure, \"ax\"  \n"
+                                  ".byte 0x0f, 0xb9, 0x3d           \n"     // ud1 <sig>(%rip), %edi
+                                  ".long 0x53053053                 \n"     // RSEQ_SIG
+                                  "4:                               \n"
+                                  "jmp   0b                         \n"
+                                  ".popsection                      \n"
+                                  "movl  $1, %k[ok]                 \n"
+                                  "jmp   6f                         \n"
+                                  "5:                               \n"
+                                  "xorl  %k[ok], %k[ok]             \n"
+                                  "6:                               \n"
+                                 : [slot] "=&r" (slot), [idx] "=&r" (idx), [s0] "=&r" (s0), [s1] "=&r" (s1)
+                                 , [t] "=&r" (t), [result] "=&r" (result), [ok] "=&r" (ok)
+                                 , [rseq_cs] "=m" (abi->rseq_cs)
+                                 : [cpu_id] "m" (abi->cpu_id), [count] "r" (static_cast<uint64_t> (count_))
+                                 , [base] "r" (slots_.get ()), [slot_size] "i" (sizeof (slot_t))
+                                 : "memory", "cc") ;
+            return ok != 0 ;
+        }
+#endif
+
+        size_t  current_slot () const {
+#if defined (__linux__)
+            const int   cpu = ::sched_getcpu () ;
+            if (0 <= cpu) {
+                return static_cast<size_t> (cpu) % count_ ;
+            }
+#endif
+            return std::hash<std::thread::id> {} (std::this_thread::get_id ()) % count_ ;
+        }
+
+        static size_t   num_cpus () {
+#if defined (__linux__)
+            const long  n = ::sysconf (_SC_NPROCESSORS_CONF) ;
+            if (0 < n) {
+                return static_cast<size_t> (n) ;
+            }
+#endif
+            return std::max (1u, std::thread::hardware_concurrency ()) ;
+        }
+    public:
+        /**
+         * Slot i starts from `root` jumped i times (the overflow stream follows the last slot).
+         * @param use_rseq  false: Always takes the `sched_getcpu` + CAS path.
+         */
+        explicit percpu_generator (const state_t &root, bool use_rseq = true) : count_ { num_cpus () } {
+            slots_.reset (new slot_t [count_]) ;
+            state_t S = root ;
+            for (size_t i = 0 ; i < count_ ; ++i) {
+                slots_ [i].states [0] = S ;
+                unsafe_jump (S) ;
+            }
+            overflow_.states [0] = S ;
+#if XOROSHIRO_RSEQ
+            // glibc registers every thread or none of them.
+            rseq_ = use_rseq && 0 < __rseq_size && static_cast<int32_t> (rseq_area ()->cpu_id) >= 0 ;
+#else
+            (void)use_rseq ;
+#endif
+        }
+
+        percpu_generator (const percpu_generator &) = delete ;
+        percpu_generator &  operator = (const percpu_generator &) = delete ;
+
+        uint64_t    next () {
+#if XOROSHIRO_RSEQ
+            if (rseq_) {
+                uint64_t    result ;
+                if (rseq_next (result)) {
+                    return result ;
+                }
+                // rseq mode never touches a slot by CAS: Unregistered threads share their own stream.
+                return XoRoShiRo::next (overflow_.states [0]) ;
+            }
+#endif
+            return XoRoShiRo::next (slots_ [current_slot ()].states [0]) ;
+        }
+
+        /// True when `next` runs in rseq critical sections.
+        bool    uses_rseq () const {
+            return rseq_ ;
+        }
+
+        /// # of per-CPU streams.
+        size_t  streams () const {
+            return count_ ;
+        }
+
+        /// Current state of the stream `i` (`streams ()`: The overflow stream, not synchronized with concurrent `next`).
+        state_t stream_state (size_t i) const {
+            const slot_t &  s = i < count_ ? slots_ [i] : overflow_ ;
+            return s.states [i < count_ && rseq_ ? s.active : 0] ;
+        }
+    } ;
+}
+
+#endif  /* XOROSHIRO_LOCKFREE */
+
+#endif /* xoroshiro_percpu_hpp__E61B0D3A_7C25_48F9_A4D0_93F2C81B5E67 */
@@ -0,0 +1,68 @@
+/**
+ * xoroshiro_tls.hpp: Per-thread default xoroshiro128+ generator.
+ *
+ * Copyright (c) 2016-2018 Masashi Fujita
+ */
+#pragma once
+#ifndef xoroshiro_tls_hpp__4EBF27E1_FF1B_494E_B7C8_C6066628307C
+#define xoroshiro_tls_hpp__4EBF27E1_FF1B_494E_B7C8_C6066628307C  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <mutex>
+
+#include "substream.hpp"
+#include "xoroshiro.hpp"
+
+namespace XoRoShiRo {
+
+    /**
+     * The root state every per-thread stream is split off from.
+     * Assign to it before the first call to `thread_state` if a different seed is desired.
+     */
+    inline state_t &    root_state () {
+        XOROSHIRO_ALIGNMENT static state_t  root { 0x9E3779B97F4A7C15ull, 0xBF58476D1CE4E5B9ull } ;
+        return root ;
+    }
+
+    namespace detail {
+#if CONTENTION_AVAILABLE
+        /// Takes the current root as a child stream and jumps the root past it.
+        inline state_t  split_root () {
+            return take_stream (root_state ()) ;
+        }
+#else
+        inline std::mutex & root_mutex () {
+            static std::mutex   m ;
+            return m ;
+        }
+
+        /// Takes the current root as a child stream and jumps the root past it.
+        inline state_t  split_root () {
+            std::lock_guard<std::mutex> lock (root_mutex ()) ;
+            state_t &   root = root_state () ;
+            state_t     child = root ;
+            unsafe_jump (root) ;
+            return child ;
+        }
+#endif
+    }
+
+    /**
+     * Returns the calling thread's private state.
+     * Seeded lazily at first use, so streams of different threads never overlap
+     * (each one is 2^64 steps apart from the others).
+     */
+    inline state_t &    thread_state () {
+        XOROSHIRO_ALIGNMENT thread_local state_t    state = detail::split_root () ;
+        return state ;
+    }
+
+    /// Draws the next value from the calling thread's private stream (no atomic ops).
+    inline uint64_t thread_next () {
+        return unsafe_next (thread_state ()) ;
+    }
+}
+
+#endif /* xoroshiro_tls_hpp__4EBF27E1_FF1B_494E_B7C8_C6066628307C */
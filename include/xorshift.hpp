@@ -13,12 +13,37 @@
 
 #include <array>
 
+/**
+ * Implements lock-free version with `__sync_val_compare_and_swap` on `unsigned __int128`
+ * instead of the inline assembly (GCC compatible compilers, requires `-mcx16` on x86-64).
+ */
+#ifndef XORSHIFT_LOCKFREE_BUILTIN
+#   if defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16) && ! defined (__clang__)
+#       define XORSHIFT_LOCKFREE_BUILTIN   1
+#   else
+#       define XORSHIFT_LOCKFREE_BUILTIN   0
+#   endif
+#endif
+
+#if XORSHIFT_LOCKFREE_BUILTIN
+#   if ! defined (__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+#       error "16 bytes compare & swap is not lock-free on this target (missing -mcx16 ?)"
+#   endif
+#   if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#       error "Builtin lock-free version assumes little endian layout."
+#   endif
+#endif
+
 /**
  * Enables lock-free version of xorshift128 PRNG.
  */
 #ifndef XORSHIFT_LOCKFREE
-#   if __x86_64__
-#       if 3 < __clang_major__
+#   if XORSHIFT_LOCKFREE_BUILTIN
+#       define XORSHIFT_LOCKFREE   1
+#   elif __x86_64__
+#       if ! defined (__clang__)
+#           define XORSHIFT_LOCKFREE   1   /* GCC: Uses inline assembly */
+#       elif 3 < __clang_major__
 #           define XORSHIFT_LOCKFREE   1
 #       else    /* __clang_major__ <=3 */
 #           if 6 < __clang_minor__
@@ -36,6 +61,23 @@
 
 #define XORSHIFT_ALIGNMENT  alignas (16)
 
+/**
+ * `constexpr` for the thread agnostic functions, when they can be evaluated at compile time
+ * (C++17: The non-const `std::array::operator []` is not `constexpr` before).
+ */
+#ifndef XORSHIFT_CONSTEXPR
+#   if 201703L <= __cplusplus || (defined (_MSVC_LANG) && 201703L <= _MSVC_LANG)
+#       define XORSHIFT_CONSTEXPR  constexpr
+#       define XORSHIFT_HAS_CONSTEXPR  1
+#   else
+#       define XORSHIFT_CONSTEXPR  inline
+#   endif
+#endif
+
+#ifndef XORSHIFT_HAS_CONSTEXPR
+#   define XORSHIFT_HAS_CONSTEXPR  0
+#endif
+
 #if defined (_WIN32) || defined (_WIN64)
 #   include <intrin.h>
 #endif
@@ -45,7 +87,60 @@ namespace XorShift {
 
 #if XORSHIFT_LOCKFREE
 
-#if defined (_WIN32) || defined (_WIN64)
+#if XORSHIFT_LOCKFREE_BUILTIN
+
+    namespace detail {
+        __extension__ typedef unsigned __int128 uint128_t ;
+        static_assert (sizeof (uint128_t) == sizeof (state_t), "state_t should be 16 bytes.") ;
+
+        inline uint128_t    load (const state_t &state) {
+            // Plain (possibly torn) read, validated by the following compare & swap.
+            return (static_cast<uint128_t> (state [1]) << 64) | state [0] ;
+        }
+    }
+
+    inline uint64_t next (state_t &state) {
+        // CMPXCHG16B requires destination was aligned to 16byte boundary.
+        assert ((reinterpret_cast<uintptr_t> (state.data ()) & 0xF) == 0) ;
+        auto *  p = reinterpret_cast<detail::uint128_t *> (state.data ()) ;
+        detail::uint128_t   S = detail::load (state) ;
+        while (true) {
+            const uint64_t  ax = static_cast<uint64_t> (S) ;
+            const uint64_t  dx = static_cast<uint64_t> (S >> 64) ;
+            uint64_t    cx = ax ;
+            cx ^= (ax << 23) ;
+            cx ^= (cx >> 18) ;
+            cx ^= dx ;
+            cx ^= (dx >> 5) ;
+            const detail::uint128_t D = (static_cast<detail::uint128_t> (cx) << 64) | dx ;
+            const detail::uint128_t prev = __sync_val_compare_and_swap (p, S, D) ;
+            if (prev == S) {
+                return dx + cx ;
+            }
+            S = prev ;
+        }
+    }
+
+    XORSHIFT_CONSTEXPR state_t &  unsafe_jump (state_t &state) ;
+
+    inline state_t &    jump (state_t &state) {
+        assert ((reinterpret_cast<uintptr_t> (state.data ()) & 0xF) == 0) ;
+        auto *  p = reinterpret_cast<detail::uint128_t *> (state.data ()) ;
+        detail::uint128_t   S = detail::load (state) ;
+        while (true) {
+            // Jumps only locally copied state, thus no atomic ops. needed.
+            state_t tmp_state { static_cast<uint64_t> (S), static_cast<uint64_t> (S >> 64) } ;
+            unsafe_jump (tmp_state) ;
+            const detail::uint128_t prev = __sync_val_compare_and_swap (p, S, detail::load (tmp_state)) ;
+            if (prev == S) {
+                break ;
+            }
+            S = prev ;
+        }
+        return state ;
+    }
+
+#elif defined (_WIN32) || defined (_WIN64)
     inline uint64_t next (state_t &state) {
         while (true) {
             XORSHIFT_ALIGNMENT auto S = state ;
@@ -108,7 +203,7 @@ namespace XorShift {
         return state ;
     }
 
-#else   /* NOT (_WIN32 OR _WIN64) */
+#else   /* NOT (XORSHIFT_LOCKFREE_BUILTIN OR _WIN32 OR _WIN64) */
 
     inline uint64_t next (state_t &state) {
         uint64_t result;
@@ -196,12 +291,12 @@ namespace XorShift {
         return state ;
     }
 
-#endif  /* NOT (_WIN32 OR _WIN64) */
+#endif  /* NOT (XORSHIFT_LOCKFREE_BUILTIN OR _WIN32 OR _WIN64) */
 
 #endif  /* ! XORSHIFT_LOCKFREE */
 
     /// Thread agnostic version of `XorShift::next`.
-    inline uint64_t unsafe_next (state_t &state) {
+    XORSHIFT_CONSTEXPR uint64_t   unsafe_next (state_t &state) {
         uint_fast64_t s1 = state [0] ;
         const uint_fast64_t s0 = state [1] ;
         uint64_t v0 = s0 ;
@@ -213,27 +308,92 @@ namespace XorShift {
     }
 
     /// Thread agnositic version of `XorShift::jump`.
-    inline state_t &    unsafe_jump (state_t &state) {
-        uint_fast64_t s0 = 0 ;
-        uint_fast64_t s1 = 0 ;
-
-        auto update = [&s0, &s1](state_t &S, uint64_t mask) {
+    XORSHIFT_CONSTEXPR state_t &  unsafe_jump (state_t &state) {
+        const uint64_t  JUMP [] = { 0x8a5cd789635d2dffull, 0x121fd2155c472f96ull } ;
+        uint64_t    s0 = 0 ;
+        uint64_t    s1 = 0 ;
+        for (uint64_t mask : JUMP) {
             for (int_fast32_t b = 0 ; b < 64 ; ++b) {
-                auto v0 = S [0] ;
-                auto v1 = S [1] ;
                 if ((mask & (1ull << b)) != 0) {
-                    s0 ^= v0 ;
-                    s1 ^= v1 ;
+                    s0 ^= state [0] ;
+                    s1 ^= state [1] ;
                 }
-                unsafe_next (S) ;
+                unsafe_next (state) ;
             }
-        } ;
-        update (state, 0x8a5cd789635d2dffull) ;
-        update (state, 0x121fd2155c472f96ull) ;
+        }
         state [0] = s0 ;
         state [1] = s1 ;
         return state ;
     }
+
+    /// Stores next `count` values into `out` (thread agnostic, keeps the state in registers).
+    XORSHIFT_CONSTEXPR void   unsafe_fill (state_t &state, uint64_t *out, size_t count) {
+        uint64_t s1 = state [0] ;
+        uint64_t s0 = state [1] ;
+        for (size_t i = 0 ; i < count ; ++i) {
+            const uint64_t t = s0 ;
+            s1 ^= s1 << 23 ;
+            s0 = s1 ^ s0 ^ (s1 >> 18) ^ (s0 >> 5) ;
+            s1 = t ;
+            out [i] = s0 + t ;
+        }
+        state [0] = s1 ;
+        state [1] = s0 ;
+    }
+
+    /**
+     * `unsafe_fill` over `LANES_` independent states, stepped in lockstep so their dependency chains overlap
+     * (instruction level parallelism without SIMD).  Stores `rounds * LANES_` values:
+     * `out [i * LANES_ + l]` is the i-th value of `states [l]`.
+     */
+    template <size_t LANES_>
+        XORSHIFT_CONSTEXPR void   unsafe_fill_interleaved (std::array<state_t, LANES_> &states, uint64_t *out, size_t rounds) {
+            static_assert (0 < LANES_, "Needs at least one lane.") ;
+            uint64_t    s1 [LANES_] {} ;
+            uint64_t    s0 [LANES_] {} ;
+            for (size_t l = 0 ; l < LANES_ ; ++l) {
+                s1 [l] = states [l][0] ;
+                s0 [l] = states [l][1] ;
+            }
+            for (size_t i = 0 ; i < rounds ; ++i) {
+                for (size_t l = 0 ; l < LANES_ ; ++l) {
+                    const uint64_t t = s0 [l] ;
+                    s1 [l] ^= s1 [l] << 23 ;
+                    s0 [l] = s1 [l] ^ s0 [l] ^ (s1 [l] >> 18) ^ (s0 [l] >> 5) ;
+                    s1 [l] = t ;
+                    out [i * LANES_ + l] = s0 [l] + t ;
+                }
+            }
+            for (size_t l = 0 ; l < LANES_ ; ++l) {
+                states [l][0] = s1 [l] ;
+                states [l][1] = s0 [l] ;
+            }
+        }
+
+    /// Expands a 64 bit seed into a (never all zero) state with SplitMix64.
+    XORSHIFT_CONSTEXPR state_t    seed_state (uint64_t seed) {
+        state_t S {} ;
+        for (auto &s : S) {
+            uint64_t    z = (seed += 0x9E3779B97F4A7C15ull) ;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull ;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull ;
+            s = z ^ (z >> 31) ;
+        }
+        return S ;
+    }
+
+    /**
+     * Next `N_` values of `state`, e.g. for Zobrist hashing or test vectors:
+     * `constexpr auto table = XorShift::make_table<768> (XorShift::seed_state (42)) ;` lives in .rodata.
+     */
+    template <size_t N_>
+        XORSHIFT_CONSTEXPR std::array<uint64_t, N_>   make_table (state_t state) {
+            std::array<uint64_t, N_>    result {} ;
+            for (size_t i = 0 ; i < N_ ; ++i) {
+                result [i] = unsafe_next (state) ;
+            }
+            return result ;
+        }
 }
 
 #endif /* end of include guard: xorshift_hpp__b71b3a16_63c6_402e_881e_d6327a69180f */
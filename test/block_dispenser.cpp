@@ -0,0 +1,93 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "block_dispenser.hpp"
+
+TEST_CASE ("Test xoroshiro128 block dispenser", "[xoroshiro][dispenser]") {
+    using dispenser_t = XoRoShiRo::block_dispenser<64, 8> ;
+
+    SECTION ("Blocks should follow the producer's stream") {
+        XoRoShiRo::state_t  S { 0, 1 } ;
+        XoRoShiRo::state_t  producer = S ;
+        dispenser_t dispenser ;
+        uint64_t    values [dispenser_t::BLOCK_SIZE] ;
+
+        REQUIRE (! dispenser.consume (values)) ;
+        for (size_t i = 0 ; i < dispenser_t::NUM_BLOCKS ; ++i) {
+            REQUIRE (dispenser.produce (producer)) ;
+        }
+        REQUIRE (! dispenser.produce (producer)) ;
+
+        for (size_t b = 0 ; b < 3 * dispenser_t::NUM_BLOCKS ; ++b) {
+            REQUIRE (dispenser.consume (values)) ;
+            for (size_t i = 0 ; i < dispenser_t::BLOCK_SIZE ; ++i) {
+                CAPTURE (b) ;
+                CAPTURE (i) ;
+                REQUIRE (values [i] == XoRoShiRo::unsafe_next (S)) ;
+            }
+            REQUIRE (dispenser.produce (producer)) ;
+        }
+    }
+
+    SECTION ("Concurrent consumers should receive every block exactly once") {
+        const size_t    NUM_PRODUCERS = 2 ;
+        const size_t    NUM_CONSUMERS = 4 ;
+        const size_t    NUM_TAKEN = 400 ;
+
+        // Expected blocks keyed by their first value.
+        std::map<uint64_t, std::vector<uint64_t>>   expected ;
+        XoRoShiRo::state_t  root { 0, 1 } ;
+        XoRoShiRo::state_t  S = root ;
+        for (size_t p = 0 ; p < NUM_PRODUCERS ; ++p) {
+            XoRoShiRo::state_t  T = S ;
+            for (size_t b = 0 ; b < NUM_TAKEN + dispenser_t::NUM_BLOCKS ; ++b) {
+                std::vector<uint64_t>   blk (dispenser_t::BLOCK_SIZE) ;
+                XoRoShiRo::unsafe_fill (T, blk.data (), blk.size ()) ;
+                expected [blk [0]] = blk ;
+            }
+            XoRoShiRo::unsafe_jump (S) ;
+        }
+
+        dispenser_t dispenser ;
+        dispenser.start (root, NUM_PRODUCERS) ;
+
+        std::atomic<size_t> taken { 0 } ;
+        std::mutex          lock ;
+        std::map<uint64_t, size_t>  seen ;
+        size_t              mismatch = 0 ;
+        std::vector<std::thread>    consumers ;
+        for (size_t c = 0 ; c < NUM_CONSUMERS ; ++c) {
+            consumers.emplace_back ([&]() {
+                while (taken.fetch_add (1) < NUM_TAKEN) {
+                    std::vector<uint64_t>   blk (dispenser_t::BLOCK_SIZE) ;
+                    while (! dispenser.consume (blk.data ())) {
+                        std::this_thread::yield () ;
+                    }
+                    std::lock_guard<std::mutex> guard (lock) ;
+                    auto it = expected.find (blk [0]) ;
+                    if (it == expected.end () || it->second != blk) {
+                        ++mismatch ;
+                    }
+                    ++seen [blk [0]] ;
+                }
+            }) ;
+        }
+        for (auto &th : consumers) {
+            th.join () ;
+        }
+        dispenser.stop () ;
+
+        REQUIRE (mismatch == 0) ;
+        REQUIRE (seen.size () == NUM_TAKEN) ;
+        for (const auto &kv : seen) {
+            REQUIRE (kv.second == 1) ;
+        }
+    }
+}
@@ -0,0 +1,78 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <thread>
+
+#include "block_ring.hpp"
+
+TEST_CASE ("Test xoroshiro128 block ring", "[xoroshiro][ring]") {
+    using ring_t = XoRoShiRo::block_ring<64, 8> ;
+
+    SECTION ("Blocks should follow the producer's stream") {
+        XoRoShiRo::state_t  S { 0, 1 } ;
+        ring_t  ring { S } ;
+
+        REQUIRE (ring.acquire () == nullptr) ;
+        for (size_t i = 0 ; i < ring_t::NUM_BLOCKS ; ++i) {
+            REQUIRE (ring.produce ()) ;
+        }
+        REQUIRE (! ring.produce ()) ;
+        REQUIRE (ring.ready () == ring_t::NUM_BLOCKS) ;
+
+        for (size_t b = 0 ; b < 3 * ring_t::NUM_BLOCKS ; ++b) {
+            const uint64_t *    blk = ring.acquire () ;
+            REQUIRE (blk != nullptr) ;
+            for (size_t i = 0 ; i < ring_t::BLOCK_SIZE ; ++i) {
+                CAPTURE (b) ;
+                CAPTURE (i) ;
+                REQUIRE (blk [i] == XoRoShiRo::unsafe_next (S)) ;
+            }
+            ring.release () ;
+            REQUIRE (ring.produce ()) ;
+        }
+    }
+
+    SECTION ("Low watermark callback should fire once per crossing") {
+        size_t  fired = 0 ;
+        ring_t  ring { XoRoShiRo::state_t { 0, 1 }, 2, [&fired](size_t) { ++fired ; } } ;
+
+        for (size_t i = 0 ; i < ring_t::NUM_BLOCKS ; ++i) {
+            ring.produce () ;
+        }
+        while (ring.acquire () != nullptr) {
+            ring.release () ;
+        }
+        REQUIRE (fired == 1) ;
+        for (size_t i = 0 ; i < ring_t::NUM_BLOCKS ; ++i) {
+            ring.produce () ;
+        }
+        ring.acquire () ;
+        ring.release () ;
+        REQUIRE (fired == 1) ;
+        while (ring.acquire () != nullptr) {
+            ring.release () ;
+        }
+        REQUIRE (fired == 2) ;
+    }
+
+    SECTION ("Background producer should keep the ring filled") {
+        XoRoShiRo::state_t  S { 0, 1 } ;
+        ring_t  ring { S } ;
+        ring.start () ;
+
+        for (size_t b = 0 ; b < 1000 ; ++b) {
+            const uint64_t *    blk ;
+            while ((blk = ring.acquire ()) == nullptr) {
+                std::this_thread::yield () ;
+            }
+            for (size_t i = 0 ; i < ring_t::BLOCK_SIZE ; ++i) {
+                if (blk [i] != XoRoShiRo::unsafe_next (S)) {
+                    FAIL ("Mismatch at block " << b << ", index " << i) ;
+                }
+            }
+            ring.release () ;
+        }
+        ring.stop () ;
+    }
+}
@@ -0,0 +1,73 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "checkpoint.hpp"
+
+TEST_CASE ("Test checkpoint", "[checkpoint]") {
+    const std::string   path = "test_checkpoint_" + std::to_string (getpid ()) + ".bin" ;
+    std::vector<Checkpoint::state_t>    states ;
+    {
+        XoRoShiRo::state_t  S { 0, 1 } ;
+        for (size_t i = 0 ; i < 10001 ; ++i) {
+            states.push_back (S) ;
+            XoRoShiRo::unsafe_jump (S) ;
+        }
+    }
+    Checkpoint::save (path, Checkpoint::kind_t::xoroshiro128_plus, states, false) ;
+
+    SECTION ("Loaded states should be equal to the saved ones") {
+        auto    loaded = Checkpoint::load (path, Checkpoint::kind_t::xoroshiro128_plus) ;
+        REQUIRE (loaded.kind () == Checkpoint::kind_t::xoroshiro128_plus) ;
+        REQUIRE (loaded.size () == states.size ()) ;
+        REQUIRE (std::vector<Checkpoint::state_t> (loaded.begin (), loaded.end ()) == states) ;
+        REQUIRE (reinterpret_cast<uintptr_t> (loaded.data ()) % 16 == 0) ;
+    }
+    SECTION ("Advancing loaded states should not modify the snapshot") {
+        {
+            auto    loaded = Checkpoint::load (path, Checkpoint::kind_t::xoroshiro128_plus) ;
+            for (auto &S : loaded) {
+                XoRoShiRo::unsafe_next (S) ;
+            }
+            REQUIRE (loaded [0] != states [0]) ;
+        }
+        auto    reloaded = Checkpoint::load (path, Checkpoint::kind_t::xoroshiro128_plus) ;
+        REQUIRE (reloaded [0] == states [0]) ;
+    }
+    SECTION ("Header should be little-endian") {
+        FILE *  f = fopen (path.c_str (), "rb") ;
+        uint8_t header [Checkpoint::HEADER_SIZE] ;
+        REQUIRE (fread (header, 1, sizeof (header), f) == sizeof (header)) ;
+        fclose (f) ;
+        REQUIRE (memcmp (header, "XSSTATE\x1A", 8) == 0) ;
+        REQUIRE (header [8] == Checkpoint::VERSION) ;
+        REQUIRE (header [12] == 2) ;
+        REQUIRE ((header [16] | (header [17] << 8)) == 10001) ;
+    }
+    SECTION ("Mismatching kind should be rejected") {
+        REQUIRE_THROWS_AS (Checkpoint::load (path, Checkpoint::kind_t::xorshift128_plus), std::system_error) ;
+    }
+    SECTION ("Corrupted snapshot should be rejected") {
+        FILE *  f = fopen (path.c_str (), "r+b") ;
+        fseek (f, Checkpoint::HEADER_SIZE + 12345, SEEK_SET) ;
+        fputc (0x5A, f) ;
+        fclose (f) ;
+        REQUIRE_THROWS_AS (Checkpoint::load (path, Checkpoint::kind_t::xoroshiro128_plus), std::system_error) ;
+        REQUIRE_NOTHROW (Checkpoint::load (path, Checkpoint::kind_t::xoroshiro128_plus, false)) ;
+    }
+    SECTION ("Truncated snapshot should be rejected") {
+        REQUIRE (truncate (path.c_str (), Checkpoint::HEADER_SIZE + 16 * 100) == 0) ;
+        REQUIRE_THROWS_AS (Checkpoint::load (path, Checkpoint::kind_t::xoroshiro128_plus), std::system_error) ;
+    }
+    SECTION ("Empty snapshot should be loadable") {
+        Checkpoint::save (path, Checkpoint::kind_t::xorshift128_plus, nullptr, 0, false) ;
+        auto    loaded = Checkpoint::load (path, Checkpoint::kind_t::xorshift128_plus) ;
+        REQUIRE (loaded.empty ()) ;
+    }
+    ::unlink (path.c_str ()) ;
+}
@@ -0,0 +1,79 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "contention.hpp"
+
+#if CONTENTION_AVAILABLE
+
+TEST_CASE ("Test instrumented lock-free generators", "[contention]") {
+    const Contention::backoff_t backoff ;
+
+    SECTION ("xorshift128 should be equal to the thread agnostic version") {
+        alignas (16) XorShift::state_t  state { 0, 1 } ;
+        XorShift::state_t   S { 0, 1 } ;
+        const auto  before = Contention::thread_stats () ;
+
+        for (int_fast32_t i = 0 ; i < 10000 ; ++i) {
+            auto expected = XorShift::unsafe_next (S) ;
+            auto actual = XorShift::next (state, backoff) ;
+            CAPTURE (i) ;
+            REQUIRE (expected == actual) ;
+        }
+        const auto  after = Contention::thread_stats () ;
+        REQUIRE (after.calls - before.calls == 10000) ;
+        REQUIRE (after.retries == before.retries) ;
+    }
+
+    SECTION ("xoroshiro128 should be equal to the thread agnostic version") {
+        alignas (16) XoRoShiRo::state_t state { 0, 1 } ;
+        XoRoShiRo::state_t  S { 0, 1 } ;
+
+        for (int_fast32_t i = 0 ; i < 10000 ; ++i) {
+            auto expected = XoRoShiRo::unsafe_next (S) ;
+            auto actual = XoRoShiRo::next (state, backoff) ;
+            CAPTURE (i) ;
+            REQUIRE (expected == actual) ;
+        }
+    }
+
+    SECTION ("Concurrent callers should draw each value exactly once") {
+        const size_t    NUM_THREADS = 4 ;
+        const size_t    NUM_CALLS = 20000 ;
+        alignas (16) XoRoShiRo::state_t state { 0, 1 } ;
+        const auto  before = Contention::total_stats () ;
+
+        std::vector<std::vector<uint64_t>>  drawn (NUM_THREADS) ;
+        std::vector<std::thread>    threads ;
+        for (size_t t = 0 ; t < NUM_THREADS ; ++t) {
+            threads.emplace_back ([&state, &drawn, &backoff, t, NUM_CALLS]() {
+                for (size_t i = 0 ; i < NUM_CALLS ; ++i) {
+                    drawn [t].push_back (XoRoShiRo::next (state, backoff)) ;
+                }
+            }) ;
+        }
+        for (auto &th : threads) {
+            th.join () ;
+        }
+        const auto  after = Contention::total_stats () ;
+        REQUIRE (after.calls - before.calls == NUM_THREADS * NUM_CALLS) ;
+
+        std::multiset<uint64_t> actual ;
+        for (const auto &v : drawn) {
+            actual.insert (v.begin (), v.end ()) ;
+        }
+        std::multiset<uint64_t> expected ;
+        XoRoShiRo::state_t  S { 0, 1 } ;
+        for (size_t i = 0 ; i < NUM_THREADS * NUM_CALLS ; ++i) {
+            expected.insert (XoRoShiRo::unsafe_next (S)) ;
+        }
+        REQUIRE (actual == expected) ;
+        REQUIRE (state == S) ;
+    }
+}
+
+#endif  /* CONTENTION_AVAILABLE */
@@ -0,0 +1,66 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "direct_writer.hpp"
+
+namespace {
+    std::vector<uint8_t>    slurp (const std::string &path) {
+        std::ifstream   in { path, std::ios::binary } ;
+        return std::vector<uint8_t> { std::istreambuf_iterator<char> { in }, std::istreambuf_iterator<char> {} } ;
+    }
+
+    std::vector<uint8_t>    expected_stream (XoRoShiRo::state_t S, uint64_t size) {
+        std::vector<uint8_t>    result ;
+        while (result.size () < size) {
+            const uint64_t  v = XoRoShiRo::unsafe_next (S) ;
+            for (size_t k = 0 ; k < 8 && result.size () < size ; ++k) {
+                result.push_back (static_cast<uint8_t> (v >> (8 * k))) ;
+            }
+        }
+        return result ;
+    }
+}
+
+TEST_CASE ("Test direct writer", "[xoroshiro][file]") {
+    const std::string   path = "test_direct_writer_" + std::to_string (getpid ()) + ".bin" ;
+    const XoRoShiRo::state_t    root { 0, 1 } ;
+    const uint64_t  size = 3 * (1u << 20) + 4101 ;  // Unaligned tail.
+    const auto      expected = expected_stream (root, size) ;
+    XoRoShiRo::direct_write_options_t   opt ;
+    opt.buffer_size = 256u << 10 ;
+    opt.queue_depth = 4 ;
+
+    SECTION ("Output should be the generator's stream") {
+        XoRoShiRo::write_file_direct (path, size, root, opt) ;
+        REQUIRE (slurp (path) == expected) ;
+    }
+    SECTION ("pwrite fallback should produce the same stream") {
+        opt.io_uring = false ;
+        const auto  used = XoRoShiRo::write_file_direct (path, size, root, opt) ;
+        REQUIRE_FALSE (used.io_uring) ;
+        REQUIRE (slurp (path) == expected) ;
+    }
+    SECTION ("Buffered writes should produce the same stream") {
+        opt.direct = false ;
+        const auto  used = XoRoShiRo::write_file_direct (path, size, root, opt) ;
+        REQUIRE_FALSE (used.direct) ;
+        REQUIRE (slurp (path) == expected) ;
+    }
+    SECTION ("Overwriting a longer file should truncate it") {
+        XoRoShiRo::write_file_direct (path, 2 * size, root, opt) ;
+        XoRoShiRo::write_file_direct (path, size, root, opt) ;
+        REQUIRE (slurp (path) == expected) ;
+    }
+    SECTION ("Unaligned buffers should be rejected") {
+        opt.buffer_size = 1000 ;
+        REQUIRE_THROWS_AS (XoRoShiRo::write_file_direct (path, size, root, opt), std::system_error) ;
+    }
+    ::unlink (path.c_str ()) ;
+}
@@ -0,0 +1,215 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "engine.hpp"
+#include "xorshift.hpp"
+#include "xoroshiro.hpp"
+
+namespace {
+    uint64_t    rotl (uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k)) ;
+    }
+
+    /// xoroshiro128** 1.0 (http://xoshiro.di.unimi.it/xoroshiro128starstar.c)
+    uint64_t    reference_star_star (uint64_t s [2]) {
+        const uint64_t s0 = s[0];
+        uint64_t s1 = s[1];
+        const uint64_t result = rotl(s0 * 5, 7) * 9;
+
+        s1 ^= s0;
+        s[0] = rotl(s0, 24) ^ s1 ^ (s1 << 16); // a, b
+        s[1] = rotl(s1, 37); // c
+
+        return result;
+    }
+}
+
+TEST_CASE ("Test policy based engine", "[engine]") {
+    const Engine::state_t   S { 0, 1 } ;
+
+    SECTION ("xorshift128+ should be equal to XorShift") {
+        Engine::xorshift128_plus<>  e { S } ;
+        XorShift::state_t   T = S ;
+        for (int_fast32_t i = 0 ; i < 10000 ; ++i) {
+            REQUIRE (e () == XorShift::unsafe_next (T)) ;
+        }
+        e.jump () ;
+        XorShift::unsafe_jump (T) ;
+        REQUIRE (e.state () == T) ;
+    }
+    SECTION ("xoroshiro128+ should be equal to XoRoShiRo") {
+        Engine::xoroshiro128_plus<> e { S } ;
+        XoRoShiRo::state_t  T = S ;
+        for (int_fast32_t i = 0 ; i < 10000 ; ++i) {
+            REQUIRE (e () == XoRoShiRo::unsafe_next (T)) ;
+        }
+        e.jump () ;
+        XoRoShiRo::unsafe_jump (T) ;
+        REQUIRE (e.state () == T) ;
+    }
+    SECTION ("Derived jump polynomials should be equal to the published ones") {
+        const auto  xs = Engine::detail::jump_polynomial<Engine::recurrence::xorshift128<23, 18, 5>> (64) ;
+        REQUIRE (xs.w [0] == 0x8a5cd789635d2dffull) ;
+        REQUIRE (xs.w [1] == 0x121fd2155c472f96ull) ;
+        const auto  xo = Engine::detail::jump_polynomial<Engine::recurrence::xoroshiro128<55, 14, 36>> (64) ;
+        REQUIRE (xo.w [0] == 0xBEAC0467EBA5FACBull) ;
+        REQUIRE (xo.w [1] == 0xD86B048B86AA9922ull) ;
+        // xoroshiro128** / ++ 1.0
+        const auto  ss = Engine::detail::jump_polynomial<Engine::recurrence::xoroshiro128<24, 16, 37>> (64) ;
+        REQUIRE (ss.w [0] == 0xdf900294d8f554a5ull) ;
+        REQUIRE (ss.w [1] == 0x170865df4b3201fcull) ;
+        const auto  pp = Engine::detail::jump_polynomial<Engine::recurrence::xoroshiro128<49, 21, 28>> (64) ;
+        REQUIRE (pp.w [0] == 0x2bd7a6a6e99c2ddcull) ;
+        REQUIRE (pp.w [1] == 0x0992ccaf6a6fca05ull) ;
+    }
+    SECTION ("xoroshiro128** should be equal to the reference implementation") {
+        Engine::xoroshiro128_star_star<>    e { S } ;
+        uint64_t    s [2] = { S [0], S [1] } ;
+        for (int_fast32_t i = 0 ; i < 10000 ; ++i) {
+            REQUIRE (e () == reference_star_star (s)) ;
+        }
+    }
+    SECTION ("Bulk fill should be equal to next") {
+        Engine::xoroshiro128_plus_plus<>    a { 42 } ;
+        Engine::xoroshiro128_plus_plus<>    b { 42 } ;
+        std::vector<uint64_t>   values (1000) ;
+        a.fill (values.data (), values.size ()) ;
+        for (auto v : values) {
+            REQUIRE (v == b ()) ;
+        }
+    }
+    SECTION ("Engines should be usable with the standard distributions") {
+        Engine::xoroshiro128_plus<> e { 1 } ;
+        std::uniform_int_distribution<int>  dist { 1, 6 } ;
+        for (int_fast32_t i = 0 ; i < 1000 ; ++i) {
+            const int   v = dist (e) ;
+            REQUIRE ((1 <= v && v <= 6)) ;
+        }
+    }
+#if CONTENTION_AVAILABLE
+    SECTION ("Shared engine should hand out each value exactly once") {
+        const size_t    T = 4 ;
+        const size_t    N = 20000 ;
+        Engine::xoroshiro128_plus<Engine::threading::cas>   shared { S } ;
+        std::vector<std::vector<uint64_t>>  drawn (T) ;
+        std::vector<std::thread>    threads ;
+        for (size_t t = 0 ; t < T ; ++t) {
+            threads.emplace_back ([&shared, &drawn, t, N]() {
+                for (size_t i = 0 ; i < N ; i += 100) {
+                    if (i % 200 == 0) {
+                        uint64_t    block [100] ;
+                        shared.fill (block, 100) ;
+                        drawn [t].insert (drawn [t].end (), block, block + 100) ;
+                    }
+                    else {
+                        for (size_t k = 0 ; k < 100 ; ++k) {
+                            drawn [t].push_back (shared ()) ;
+                        }
+                    }
+                }
+            }) ;
+        }
+        for (auto &th : threads) {
+            th.join () ;
+        }
+        std::vector<uint64_t>   actual ;
+        for (const auto &v : drawn) {
+            actual.insert (actual.end (), v.begin (), v.end ()) ;
+        }
+        std::vector<uint64_t>   expected (T * N) ;
+        Engine::xoroshiro128_plus<> { S }.fill (expected.data (), expected.size ()) ;
+        std::sort (actual.begin (), actual.end ()) ;
+        std::sort (expected.begin (), expected.end ()) ;
+        REQUIRE (actual == expected) ;
+    }
+    SECTION ("Per-CPU engine should draw from jump-separated streams") {
+        Engine::xoroshiro128_plus<Engine::threading::per_cpu>   e { S } ;
+        REQUIRE (0 < e.storage ().streams ()) ;
+        const uint64_t  v = e () ;
+        bool    found = false ;
+        XoRoShiRo::state_t  T = S ;
+        for (size_t i = 0 ; i < e.storage ().streams () ; ++i) {
+            XoRoShiRo::state_t  U = T ;
+            found = found || XoRoShiRo::unsafe_next (U) == v ;
+            XoRoShiRo::unsafe_jump (T) ;
+        }
+        REQUIRE (found) ;
+    }
+#endif
+    SECTION ("Random access should be equal to stepping") {
+        using xoroshiro_t = Engine::recurrence::xoroshiro128<55, 14, 36> ;
+        const auto &    table = Engine::detail::advance_table<xoroshiro_t>::instance () ;
+        XoRoShiRo::state_t  T = S ;
+        uint64_t    pos = 0 ;
+        for (uint64_t n : { 0u, 1u, 255u, 256u, 257u, 1000u, 65537u, 300000u }) {
+            for ( ; pos < n ; ++pos) {
+                XoRoShiRo::unsafe_next (T) ;
+            }
+            Engine::state_t U = S ;
+            table.advance (U, n) ;
+            CAPTURE (n) ;
+            REQUIRE (U == T) ;
+        }
+    }
+    SECTION ("Random access to the end of the stream should meet the published jump") {
+        Engine::state_t U = S ;
+        Engine::detail::advance_table<Engine::recurrence::xoroshiro128<55, 14, 36>>::instance ().advance (U, ~0ull) ;
+        XoRoShiRo::unsafe_next (U) ;
+        XoRoShiRo::state_t  T = S ;
+        REQUIRE (U == XoRoShiRo::unsafe_jump (T)) ;
+
+        Engine::state_t V = S ;
+        Engine::detail::advance_table<Engine::recurrence::xorshift128<23, 18, 5>>::instance ().advance (V, ~0ull) ;
+        XorShift::unsafe_next (V) ;
+        XorShift::state_t   W = S ;
+        REQUIRE (V == XorShift::unsafe_jump (W)) ;
+    }
+    SECTION ("Wait-free engine should hand out each value exactly once") {
+        const size_t    T = 4 ;
+        const size_t    N = 20000 ;
+        Engine::xorshift128_plus<Engine::threading::wait_free>  shared { S } ;
+        std::vector<std::vector<uint64_t>>  drawn (T) ;
+        std::vector<std::thread>    threads ;
+        for (size_t t = 0 ; t < T ; ++t) {
+            threads.emplace_back ([&shared, &drawn, t, N]() {
+                for (size_t i = 0 ; i < N ; i += 100) {
+                    if (i % 200 == 0) {
+                        uint64_t    block [100] ;
+                        shared.fill (block, 100) ;
+                        drawn [t].insert (drawn [t].end (), block, block + 100) ;
+                    }
+                    else {
+                        for (size_t k = 0 ; k < 100 ; ++k) {
+                            drawn [t].push_back (shared ()) ;
+                        }
+                    }
+                }
+            }) ;
+        }
+        for (auto &th : threads) {
+            th.join () ;
+        }
+        REQUIRE (shared.storage ().index () == T * N) ;
+        std::vector<uint64_t>   actual ;
+        for (const auto &v : drawn) {
+            actual.insert (actual.end (), v.begin (), v.end ()) ;
+        }
+        std::vector<uint64_t>   expected (T * N) ;
+        Engine::xorshift128_plus<> { S }.fill (expected.data (), expected.size ()) ;
+        std::sort (actual.begin (), actual.end ()) ;
+        std::sort (expected.begin (), expected.end ()) ;
+        REQUIRE (actual == expected) ;
+
+        XorShift::state_t   U = S ;
+        for (size_t i = 0 ; i < T * N ; ++i) {
+            XorShift::unsafe_next (U) ;
+        }
+        REQUIRE (shared.state () == U) ;
+    }
+}
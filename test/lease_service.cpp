@@ -0,0 +1,214 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "lease_service.hpp"
+
+namespace {
+    /// Stops and joins the serving thread on scope exit (also when a REQUIRE fails).
+    struct serving_t {
+        LeaseService::server &  server ;
+        std::thread             th ;
+
+        explicit serving_t (LeaseService::server &s) : server (s), th { [&s]() { s.serve () ; } } {
+            /* NO-OP */
+        }
+
+        ~serving_t () {
+            server.stop () ;
+            th.join () ;
+        }
+    } ;
+}
+
+TEST_CASE ("Test stream lease service", "[lease_service]") {
+    const std::string           path = "test_lease_service_" + std::to_string (getpid ()) + ".sock" ;
+    const XoRoShiRo::state_t    root = XoRoShiRo::seed_state (42) ;
+
+    std::vector<XoRoShiRo::state_t> expected ;
+    {
+        XoRoShiRo::state_t  S = root ;
+        for (size_t i = 0 ; i < 1000 ; ++i) {
+            expected.push_back (S) ;
+            XoRoShiRo::unsafe_jump (S) ;
+        }
+    }
+
+    LeaseService::server    server { path, root } ;
+    serving_t   serving { server } ;
+
+    SECTION ("Streams should be handed out in jump order") {
+        LeaseService::client    C { path } ;
+        uint64_t    index = ~0ull ;
+        REQUIRE (C.take (3, &index) == std::vector<XoRoShiRo::state_t> (expected.begin (), expected.begin () + 3)) ;
+        REQUIRE (index == 0) ;
+        REQUIRE (C.take (1, &index) == std::vector<XoRoShiRo::state_t> { expected [3] }) ;
+        REQUIRE (index == 3) ;
+    }
+
+    SECTION ("Pipelined requests should be answered in order") {
+        LeaseService::client    C { path } ;
+        for (size_t i = 0 ; i < 100 ; ++i) {
+            C.post (2) ;
+        }
+        REQUIRE (C.pending () == 100) ;
+        for (size_t i = 0 ; i < 100 ; ++i) {
+            uint64_t    index ;
+            const auto  streams = C.wait (&index) ;
+            CAPTURE (i) ;
+            REQUIRE (index == 2 * i) ;
+            REQUIRE (streams == std::vector<XoRoShiRo::state_t> (expected.begin () + 2 * i, expected.begin () + 2 * i + 2)) ;
+        }
+        REQUIRE (C.pending () == 0) ;
+    }
+
+    SECTION ("Pipelining past the server's buffer limits should not deadlock") {
+        // 48 bytes responses: ~9.6 MiB in flight (past OUTPUT_HIGH_WATER), 3.2 MB of requests (past INPUT_LIMIT).
+        const size_t    NUM_REQUESTS = 200000 ;
+        LeaseService::client    C { path } ;
+        uint64_t    next_index = 0 ;
+        for (const bool flush : { true, false }) {
+            for (size_t i = 0 ; i < NUM_REQUESTS ; ++i) {
+                C.post (1) ;
+            }
+            if (flush) {
+                C.flush () ;
+            }
+            for (size_t i = 0 ; i < NUM_REQUESTS ; ++i) {
+                uint64_t    index ;
+                C.wait (&index) ;
+                if (index != next_index) {
+                    CAPTURE (flush) ;
+                    CAPTURE (i) ;
+                    REQUIRE (index == next_index) ;
+                }
+                ++next_index ;
+            }
+        }
+        REQUIRE (C.pending () == 0) ;
+        REQUIRE (server.issued () == 2 * NUM_REQUESTS) ;
+    }
+
+    SECTION ("Malformed requests should be refused without breaking the connection") {
+        LeaseService::client    C { path } ;
+        C.post (0) ;
+        C.post (LeaseService::MAX_STREAMS + 1) ;
+        C.post (1) ;
+        REQUIRE_THROWS_AS (C.wait (), std::system_error) ;
+        REQUIRE_THROWS_AS (C.wait (), std::system_error) ;
+        REQUIRE (C.wait () == std::vector<XoRoShiRo::state_t> { expected [0] }) ;
+    }
+
+    SECTION ("Concurrent clients should never share a stream") {
+        const size_t    NUM_CLIENTS = 4 ;
+        const size_t    NUM_CALLS = 50 ;
+        std::vector<std::vector<XoRoShiRo::state_t>>    taken (NUM_CLIENTS) ;
+        std::vector<std::thread>    clients ;
+        for (size_t t = 0 ; t < NUM_CLIENTS ; ++t) {
+            clients.emplace_back ([&path, &taken, t, NUM_CALLS]() {
+                LeaseService::client    C { path } ;
+                for (size_t i = 0 ; i < NUM_CALLS ; ++i) {
+                    taken [t].push_back (C.take () [0]) ;
+                }
+            }) ;
+        }
+        for (auto &c : clients) {
+            c.join () ;
+        }
+        std::set<XoRoShiRo::state_t>    actual ;
+        for (const auto &v : taken) {
+            actual.insert (v.begin (), v.end ()) ;
+        }
+        REQUIRE (actual == std::set<XoRoShiRo::state_t> (expected.begin (), expected.begin () + NUM_CLIENTS * NUM_CALLS)) ;
+        REQUIRE (server.issued () == NUM_CLIENTS * NUM_CALLS) ;
+    }
+
+    SECTION ("A client that never reads should not make the server buffer without bound") {
+        const size_t    NUM_REQUESTS = 1000 ;   // ~64 GiB of responses if answered at once.
+        const sockaddr_un   addr = LeaseService::detail::address_of (path) ;
+        const int   fd = ::socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) ;
+        REQUIRE (0 <= fd) ;
+        REQUIRE (::connect (fd, reinterpret_cast<const sockaddr *> (&addr), sizeof (addr)) == 0) ;
+        std::vector<uint8_t>    requests (NUM_REQUESTS * LeaseService::REQUEST_SIZE) ;
+        for (size_t i = 0 ; i < NUM_REQUESTS ; ++i) {
+            LeaseService::detail::store_le (&requests [i * LeaseService::REQUEST_SIZE], LeaseService::detail::REQUEST_MAGIC, 4) ;
+            LeaseService::detail::store_le (&requests [i * LeaseService::REQUEST_SIZE + 4], LeaseService::MAX_STREAMS, 4) ;
+        }
+        const ssize_t   sent = ::send (fd, requests.data (), requests.size (), MSG_NOSIGNAL) ;
+        std::this_thread::sleep_for (std::chrono::milliseconds (200)) ;
+        CAPTURE (sent) ;
+        // The high-water mark plus what the socket buffers could absorb.
+        REQUIRE (server.issued () * sizeof (XoRoShiRo::state_t) < 4 * LeaseService::OUTPUT_HIGH_WATER) ;
+        ::close (fd) ;
+        // The server should still serve others.
+        LeaseService::client    C { path } ;
+        REQUIRE (C.take ().size () == 1) ;
+    }
+
+    SECTION ("A live server's socket should not be taken over") {
+        REQUIRE_THROWS_AS (LeaseService::server (path, root), std::system_error) ;
+        LeaseService::client    C { path } ;
+        REQUIRE (C.take () == std::vector<XoRoShiRo::state_t> { expected [0] }) ;
+    }
+}
+
+TEST_CASE ("Test stream lease service socket files", "[lease_service]") {
+    const std::string           path = "test_lease_service_file_" + std::to_string (getpid ()) + ".sock" ;
+    const XoRoShiRo::state_t    root = XoRoShiRo::seed_state (42) ;
+
+    SECTION ("Other files should not be replaced") {
+        FILE *  f = fopen (path.c_str (), "w") ;
+        REQUIRE (f != nullptr) ;
+        fclose (f) ;
+        REQUIRE_THROWS_AS (LeaseService::server (path, root), std::system_error) ;
+        struct stat st ;
+        REQUIRE (::stat (path.c_str (), &st) == 0) ;
+        REQUIRE (S_ISREG (st.st_mode)) ;
+        ::unlink (path.c_str ()) ;
+    }
+
+    SECTION ("A stale socket should be replaced") {
+        {
+            // Leaves a socket file without a listener behind.
+            const sockaddr_un   addr = LeaseService::detail::address_of (path) ;
+            const int   fd = ::socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0) ;
+            REQUIRE (0 <= fd) ;
+            REQUIRE (::bind (fd, reinterpret_cast<const sockaddr *> (&addr), sizeof (addr)) == 0) ;
+            ::close (fd) ;
+        }
+        LeaseService::server    server { path, root } ;
+        serving_t   serving { server } ;
+        REQUIRE (LeaseService::client { path }.take () == std::vector<XoRoShiRo::state_t> { root }) ;
+    }
+}
+
+TEST_CASE ("Test stream lease service with long jumps", "[lease_service]") {
+    using recurrence_t = Engine::recurrence::xoroshiro128<55, 14, 36> ;
+    const std::string           path = "test_lease_service_long_" + std::to_string (getpid ()) + ".sock" ;
+    const XoRoShiRo::state_t    root = XoRoShiRo::seed_state (42) ;
+
+    LeaseService::server    server { path, root, LeaseService::stride_t::long_jump } ;
+    std::vector<XoRoShiRo::state_t> streams ;
+    {
+        serving_t   serving { server } ;
+        streams = LeaseService::client { path }.take (2) ;
+    }
+
+    // 2^96 = 2^95 + 2^95
+    XoRoShiRo::state_t  S = root ;
+    const auto  HALF = Engine::detail::jump_polynomial<recurrence_t> (95) ;
+    Engine::detail::apply_polynomial<recurrence_t> (HALF, S) ;
+    Engine::detail::apply_polynomial<recurrence_t> (HALF, S) ;
+    REQUIRE (streams [0] == root) ;
+    REQUIRE (streams [1] == S) ;
+}
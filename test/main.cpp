@@ -1,2 +1,4 @@
 #define CATCH_CONFIG_MAIN
+// Catch's alternate signal stack uses SIGSTKSZ, which is no longer a constant in recent glibc.
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
 #include "catch.hpp"
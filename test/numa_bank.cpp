@@ -0,0 +1,56 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+#include "numa_bank.hpp"
+#include "xoroshiro.hpp"
+
+TEST_CASE ("Test NUMA aware state banks", "[numa]") {
+    SECTION ("Topology should be sane on any host") {
+        REQUIRE (1 <= Numa::node_count ()) ;
+        REQUIRE (0 <= Numa::node_of_cpu (0)) ;
+        REQUIRE (static_cast<size_t> (Numa::node_of_cpu (0)) < Numa::node_count ()) ;
+        REQUIRE (static_cast<size_t> (Numa::current_node ()) < Numa::node_count ()) ;
+    }
+
+    for (auto placement : { Numa::placement_t::first_touch, Numa::placement_t::bind }) {
+        SECTION (placement == Numa::placement_t::bind ? "Bound shards should be usable and local" : "First-touched shards should be usable and local") {
+            const size_t    NUM_THREADS = 4 ;
+            Numa::shard_bank    bank { NUM_THREADS, 1000, placement } ;
+            REQUIRE (bank.shards () == NUM_THREADS) ;
+            REQUIRE (bank.buffer_words () == 1000) ;
+
+            std::vector<int>    nodes (NUM_THREADS) ;
+            std::vector<std::thread>    threads ;
+            for (size_t t = 0 ; t < NUM_THREADS ; ++t) {
+                threads.emplace_back ([&bank, &nodes, t]() {
+                    auto &  S = bank.place (t, XoRoShiRo::state_t { t, 1 }) ;
+                    XoRoShiRo::unsafe_fill (S, bank.buffer (t), bank.buffer_words ()) ;
+                    nodes [t] = Numa::current_node () ;
+                }) ;
+            }
+            for (auto &th : threads) {
+                th.join () ;
+            }
+            for (size_t t = 0 ; t < NUM_THREADS ; ++t) {
+                CAPTURE (t) ;
+                REQUIRE ((reinterpret_cast<uintptr_t> (bank.state (t).data ()) % 64) == 0) ;
+                XoRoShiRo::state_t  S { t, 1 } ;
+                std::vector<uint64_t>   expected (1000) ;
+                XoRoShiRo::unsafe_fill (S, expected.data (), expected.size ()) ;
+                REQUIRE (std::vector<uint64_t> (bank.buffer (t), bank.buffer (t) + 1000) == expected) ;
+                REQUIRE (bank.state (t) == S) ;
+                if (Numa::available ()) {
+                    // Single node hosts trivially pass, multi node ones unless a thread migrated.
+                    REQUIRE (0 <= bank.node_of (t)) ;
+                    if (Numa::node_count () == 1) {
+                        REQUIRE (bank.node_of (t) == nodes [t]) ;
+                    }
+                }
+            }
+        }
+    }
+}
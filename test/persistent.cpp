@@ -0,0 +1,112 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+#include <stdio.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "persistent.hpp"
+
+TEST_CASE ("Test leased generators", "[persistent]") {
+    using leased_t = Persistent::leased_xoroshiro128_plus ;
+    using core_t = leased_t::core_type ;
+
+    const std::string       path = "test_persistent_" + std::to_string (getpid ()) + ".lease" ;
+    const Persistent::state_t   seed = Engine::seed_state (42) ;
+    ::unlink (path.c_str ()) ;
+
+    // Values of the stream from `seed`.
+    std::vector<uint64_t>   expected (8192) ;
+    {
+        Persistent::state_t S = seed ;
+        core_t::unsafe_fill (S, expected.data (), expected.size ()) ;
+    }
+
+    SECTION ("Values should follow the stream, leasing a block at a time") {
+        leased_t    G { path, seed, 10 } ;
+        REQUIRE (! G.resumed ()) ;
+        REQUIRE (G.leases () == 0) ;
+        for (size_t i = 0 ; i < 3000 ; ++i) {
+            CAPTURE (i) ;
+            REQUIRE (G () == expected [i]) ;
+        }
+        REQUIRE (G.leases () == 3) ;
+        REQUIRE (G.remaining () == 3 * 1024 - 3000) ;
+
+        std::vector<uint64_t>   buf (2100) ;
+        G.fill (buf.data (), buf.size ()) ;
+        REQUIRE (std::vector<uint64_t> (expected.begin () + 3000, expected.begin () + 5100) == buf) ;
+        REQUIRE (G.leases () == 5) ;
+    }
+
+    SECTION ("A restarted generator should resume after the last lease") {
+        {
+            leased_t    G { path, seed, 10 } ;
+            for (size_t i = 0 ; i < 3000 ; ++i) {
+                G () ;
+            }
+        }
+        leased_t    G { path, Engine::seed_state (1), 10 } ;
+        REQUIRE (G.resumed ()) ;
+        REQUIRE (G.leases () == 3) ;
+        REQUIRE (G () == expected [3 * 1024]) ;
+        REQUIRE (G.leases () == 4) ;
+    }
+
+    SECTION ("A torn record should fall back to the previous lease") {
+        {
+            leased_t    G { path, seed, 10 } ;
+            for (size_t i = 0 ; i < 3000 ; ++i) {
+                G () ;
+            }
+        }
+        {
+            // Lease 3 lives in record 1.
+            FILE *  f = fopen (path.c_str (), "r+b") ;
+            REQUIRE (f != nullptr) ;
+            fseek (f, 128 + 8, SEEK_SET) ;
+            fputc (0x55, f) ;
+            fclose (f) ;
+        }
+        leased_t    G { path, seed, 10 } ;
+        REQUIRE (G.leases () == 2) ;
+        REQUIRE (G () == expected [2 * 1024]) ;
+    }
+
+    SECTION ("A new file should be linked into place with no temporary left behind") {
+        {
+            leased_t    G { path, seed, 10 } ;
+            REQUIRE (::access (path.c_str (), F_OK) == 0) ;
+        }
+        const std::string   prefix = path + ".tmp." ;
+        DIR *   d = ::opendir (".") ;
+        REQUIRE (d != nullptr) ;
+        size_t  leftovers = 0 ;
+        while (const dirent *e = ::readdir (d)) {
+            leftovers += std::string { e->d_name }.compare (0, prefix.size (), prefix) == 0 ? 1 : 0 ;
+        }
+        ::closedir (d) ;
+        REQUIRE (leftovers == 0) ;
+        leased_t    G { path, seed, 10 } ;
+        REQUIRE (G.resumed ()) ;
+        REQUIRE (G () == expected [0]) ;
+    }
+
+    SECTION ("The file should be held by a single generator") {
+        leased_t    G { path, seed, 10 } ;
+        REQUIRE_THROWS_AS (leased_t (path, seed, 10), std::system_error) ;
+    }
+
+    SECTION ("Files of other generators should be rejected") {
+        {
+            leased_t    G { path, seed, 10 } ;
+        }
+        REQUIRE_THROWS_AS (Persistent::leased_xorshift128_plus (path, seed, 10), std::system_error) ;
+        REQUIRE_THROWS_AS (leased_t (path, seed, 0), std::system_error) ;
+    }
+    ::unlink (path.c_str ()) ;
+}
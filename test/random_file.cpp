@@ -0,0 +1,65 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "random_file.hpp"
+
+namespace {
+    std::vector<uint8_t>    slurp (const std::string &path) {
+        std::ifstream   in { path, std::ios::binary } ;
+        return std::vector<uint8_t> { std::istreambuf_iterator<char> { in }, std::istreambuf_iterator<char> {} } ;
+    }
+}
+
+TEST_CASE ("Test random file materialization", "[xoroshiro][file]") {
+    const std::string   path = "test_random_file_" + std::to_string (getpid ()) + ".bin" ;
+    const XoRoShiRo::state_t    root { 0, 1 } ;
+    XoRoShiRo::materialize_options_t    opt ;
+    opt.region_size = 2u << 20 ;
+
+    SECTION ("Regions should be filled from jump-separated streams") {
+        const uint64_t  size = 5 * (1u << 20) + 13 ;
+        opt.threads = 3 ;
+        XoRoShiRo::materialize_file (path, size, root, opt) ;
+        const auto  actual = slurp (path) ;
+        REQUIRE (actual.size () == size) ;
+
+        std::vector<uint8_t>    expected ;
+        XoRoShiRo::state_t  S = root ;
+        for (uint64_t offset = 0 ; offset < size ; offset += opt.region_size) {
+            XoRoShiRo::state_t  T = S ;
+            const uint64_t      len = std::min<uint64_t> (opt.region_size, size - offset) ;
+            for (uint64_t i = 0 ; i < len ; i += 8) {
+                const uint64_t  v = XoRoShiRo::unsafe_next (T) ;
+                for (uint64_t k = 0 ; k < 8 && i + k < len ; ++k) {
+                    expected.push_back (static_cast<uint8_t> (v >> (8 * k))) ;
+                }
+            }
+            XoRoShiRo::unsafe_jump (S) ;
+        }
+        REQUIRE (actual == expected) ;
+    }
+
+    SECTION ("Content should not depend on the # of threads") {
+        const uint64_t  size = 7 * (1u << 20) ;
+        opt.threads = 1 ;
+        XoRoShiRo::materialize_file (path, size, root, opt) ;
+        const auto  single = slurp (path) ;
+        opt.threads = 4 ;
+        XoRoShiRo::materialize_file (path, size, root, opt) ;
+        REQUIRE (slurp (path) == single) ;
+    }
+
+    SECTION ("Bad region size should be rejected") {
+        opt.region_size = 12345 ;
+        REQUIRE_THROWS_AS (XoRoShiRo::materialize_file (path, 1000, root, opt), std::system_error) ;
+    }
+    ::unlink (path.c_str ()) ;
+}
@@ -0,0 +1,136 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shared_state.hpp"
+
+#if XORSHIFT_LOCKFREE && XOROSHIRO_LOCKFREE
+
+TEST_CASE ("Test shared memory generator states", "[shared_state]") {
+    using SharedState::region ;
+    using Checkpoint::kind_t ;
+
+    const XoRoShiRo::state_t    root = XoRoShiRo::seed_state (42) ;
+
+    SECTION ("Shards and the root should follow the jump sequence") {
+        auto    R = region::anonymous (kind_t::xoroshiro128_plus, root, 3) ;
+        REQUIRE (R.shards () == 3) ;
+        XoRoShiRo::state_t  S = root ;
+        for (size_t i = 0 ; i < 3 ; ++i) {
+            CAPTURE (i) ;
+            REQUIRE (R.shard (i) == S) ;
+            REQUIRE ((reinterpret_cast<uintptr_t> (R.shard (i).data ()) & 0x3F) == 0) ;
+            XoRoShiRo::unsafe_jump (S) ;
+        }
+        REQUIRE (R.state () == S) ;
+        for (int_fast32_t i = 0 ; i < 1000 ; ++i) {
+            REQUIRE (R.next () == XoRoShiRo::unsafe_next (S)) ;
+        }
+        XoRoShiRo::state_t  T = R.shard (1) ;
+        REQUIRE (R.next_shard (1) == XoRoShiRo::unsafe_next (T)) ;
+        REQUIRE (R.shard (1) == T) ;
+    }
+
+    SECTION ("xorshift128 regions should use xorshift128") {
+        auto    R = region::anonymous (kind_t::xorshift128_plus, root) ;
+        XorShift::state_t   S = root ;
+        for (int_fast32_t i = 0 ; i < 1000 ; ++i) {
+            REQUIRE (R.next () == XorShift::unsafe_next (S)) ;
+        }
+        R.jump () ;
+        XorShift::unsafe_jump (S) ;
+        REQUIRE (R.state () == S) ;
+    }
+
+    SECTION ("Shards should be claimed once") {
+        auto    R = region::anonymous (kind_t::xoroshiro128_plus, root, 2) ;
+        REQUIRE (R.claim_shard () == 0) ;
+        REQUIRE (R.claim_shard () == 1) ;
+        REQUIRE_THROWS_AS (R.claim_shard (), std::system_error) ;
+        REQUIRE_THROWS_AS (R.shard (2), std::out_of_range) ;
+        REQUIRE_THROWS_AS (R.next_shard (2), std::out_of_range) ;
+    }
+
+    SECTION ("Named regions should be attachable by name and kind") {
+        const std::string   name = "/xorshift-test-" + std::to_string (::getpid ()) ;
+        auto    R = region::create (name, kind_t::xoroshiro128_plus, root, 1) ;
+        REQUIRE_THROWS_AS (region::create (name, kind_t::xoroshiro128_plus, root), std::system_error) ;
+        REQUIRE_THROWS_AS (region::open (name, kind_t::xorshift128_plus), std::system_error) ;
+        auto    A = region::open (name, kind_t::xoroshiro128_plus) ;
+        const uint64_t  v = R.next () ;
+        REQUIRE (v != A.next ()) ;
+        XoRoShiRo::state_t  S = root ;
+        XoRoShiRo::unsafe_jump (S) ;
+        XoRoShiRo::unsafe_next (S) ;
+        XoRoShiRo::unsafe_next (S) ;
+        REQUIRE (A.state () == S) ;
+        region::unlink (name) ;
+        REQUIRE_THROWS_AS (region::open (name, kind_t::xoroshiro128_plus), std::system_error) ;
+    }
+
+    SECTION ("Processes should draw each value exactly once") {
+        const size_t    N = 2000 ;
+        auto    R = region::anonymous (kind_t::xoroshiro128_plus, root) ;
+        int     fds [2] ;
+        REQUIRE (::pipe (fds) == 0) ;
+        const pid_t pid = ::fork () ;
+        REQUIRE (0 <= pid) ;
+        if (pid == 0) {
+            // Never lets an exception reach Catch: The child would go on running the rest of the suite.
+            try {
+                ::close (fds [0]) ;
+                auto    C = region::attach (R.fd (), kind_t::xoroshiro128_plus) ;
+                std::vector<uint64_t>   drawn ;
+                for (size_t i = 0 ; i < N ; ++i) {
+                    drawn.push_back (C.next ()) ;
+                }
+                const auto  size = static_cast<ssize_t> (drawn.size () * sizeof (uint64_t)) ;
+                ::_exit (::write (fds [1], drawn.data (), static_cast<size_t> (size)) == size ? 0 : 1) ;
+            }
+            catch (...) {
+                ::_exit (1) ;
+            }
+        }
+        ::close (fds [1]) ;
+        std::vector<uint64_t>   actual ;
+        for (size_t i = 0 ; i < N ; ++i) {
+            actual.push_back (R.next ()) ;
+        }
+        std::vector<uint64_t>   child (N) ;
+        size_t  got = 0 ;
+        while (got < N * sizeof (uint64_t)) {
+            const ssize_t   r = ::read (fds [0], reinterpret_cast<char *> (child.data ()) + got, N * sizeof (uint64_t) - got) ;
+            if (r <= 0) {
+                break ;
+            }
+            got += static_cast<size_t> (r) ;
+        }
+        ::close (fds [0]) ;
+        int status = 0 ;
+        REQUIRE (::waitpid (pid, &status, 0) == pid) ;
+        REQUIRE (WIFEXITED (status)) ;
+        REQUIRE (WEXITSTATUS (status) == 0) ;
+        REQUIRE (got == N * sizeof (uint64_t)) ;
+
+        actual.insert (actual.end (), child.begin (), child.end ()) ;
+        std::vector<uint64_t>   expected ;
+        XoRoShiRo::state_t  S = root ;
+        for (size_t i = 0 ; i < 2 * N ; ++i) {
+            expected.push_back (XoRoShiRo::unsafe_next (S)) ;
+        }
+        std::sort (actual.begin (), actual.end ()) ;
+        std::sort (expected.begin (), expected.end ()) ;
+        REQUIRE (actual == expected) ;
+    }
+}
+
+#endif  /* XORSHIFT_LOCKFREE && XOROSHIRO_LOCKFREE */
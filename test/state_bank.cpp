@@ -0,0 +1,85 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <vector>
+
+#include "state_bank.hpp"
+
+TEST_CASE ("Test structure-of-arrays state bank", "[state_bank]") {
+    const size_t    N = 1003 ;  // Not a multiple of the vector width.
+    const XoRoShiRo::state_t    root = XoRoShiRo::seed_state (42) ;
+
+    std::vector<XoRoShiRo::state_t> states ;
+    {
+        XoRoShiRo::state_t  S = root ;
+        for (size_t i = 0 ; i < N ; ++i) {
+            states.push_back (S) ;
+            XoRoShiRo::unsafe_jump (S) ;
+        }
+    }
+    XoRoShiRo::state_bank   bank { N, root } ;
+
+    SECTION ("Streams should be jump-separated and aligned") {
+        REQUIRE (bank.size () == N) ;
+        REQUIRE (reinterpret_cast<uintptr_t> (bank.s0 ()) % XoRoShiRo::state_bank::ALIGNMENT == 0) ;
+        REQUIRE (reinterpret_cast<uintptr_t> (bank.s1 ()) % XoRoShiRo::state_bank::ALIGNMENT == 0) ;
+        for (size_t i = 0 ; i < N ; ++i) {
+            REQUIRE (bank.get (i) == states [i]) ;
+        }
+    }
+
+    SECTION ("next_all should be equal to the thread agnostic version") {
+        std::vector<uint64_t>   out (N) ;
+        for (int_fast32_t r = 0 ; r < 10 ; ++r) {
+            bank.next_all (out.data ()) ;
+            for (size_t i = 0 ; i < N ; ++i) {
+                CAPTURE (r) ;
+                CAPTURE (i) ;
+                REQUIRE (out [i] == XoRoShiRo::unsafe_next (states [i])) ;
+            }
+        }
+    }
+
+    SECTION ("advance_all should skip the outputs") {
+        bank.advance_all (7) ;
+        bank.advance_all () ;
+        for (size_t i = 0 ; i < N ; ++i) {
+            for (int_fast32_t k = 0 ; k < 8 ; ++k) {
+                XoRoShiRo::unsafe_next (states [i]) ;
+            }
+            REQUIRE (bank.get (i) == states [i]) ;
+        }
+    }
+
+    SECTION ("next_masked should only advance the listed streams") {
+        std::vector<XoRoShiRo::state_bank::index_t> indices ;
+        for (size_t i = 5 ; i < N ; i += 3) {
+            indices.push_back (static_cast<XoRoShiRo::state_bank::index_t> (i)) ;
+        }
+        std::vector<uint64_t>   out (indices.size ()) ;
+        bank.next_masked (indices.data (), indices.size (), out.data ()) ;
+        for (size_t k = 0 ; k < indices.size () ; ++k) {
+            REQUIRE (out [k] == XoRoShiRo::unsafe_next (states [indices [k]])) ;
+        }
+        for (size_t i = 0 ; i < N ; ++i) {
+            CAPTURE (i) ;
+            REQUIRE (bank.get (i) == states [i]) ;
+        }
+    }
+
+    SECTION ("gather and scatter should move states in and out") {
+        const std::vector<XoRoShiRo::state_bank::index_t>   indices { 1000, 3, 77 } ;
+        std::vector<XoRoShiRo::state_t> taken (indices.size ()) ;
+        bank.gather (indices.data (), indices.size (), taken.data ()) ;
+        for (size_t k = 0 ; k < indices.size () ; ++k) {
+            REQUIRE (taken [k] == states [indices [k]]) ;
+            XoRoShiRo::unsafe_jump (taken [k]) ;
+        }
+        bank.scatter (indices.data (), indices.size (), taken.data ()) ;
+        for (size_t k = 0 ; k < indices.size () ; ++k) {
+            REQUIRE (bank.get (indices [k]) == taken [k]) ;
+        }
+        REQUIRE (bank.get (4) == states [4]) ;
+    }
+}
@@ -0,0 +1,83 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "substream.hpp"
+
+TEST_CASE ("Test tabulated jump", "[substream]") {
+    SECTION ("xorshift128 table should be equal to unsafe_jump") {
+        XorShift::state_t   S { 0, 1 } ;
+        for (int_fast32_t i = 0 ; i < 100 ; ++i) {
+            XorShift::state_t   actual ;
+            XorShift::jump_table ().apply (S, actual) ;
+            XorShift::unsafe_jump (S) ;
+            CAPTURE (i) ;
+            REQUIRE (actual == S) ;
+            XorShift::unsafe_next (S) ;
+        }
+    }
+
+    SECTION ("xoroshiro128 table should be equal to unsafe_jump") {
+        XoRoShiRo::state_t  S = XoRoShiRo::seed_state (42) ;
+        for (int_fast32_t i = 0 ; i < 100 ; ++i) {
+            XoRoShiRo::state_t  actual ;
+            XoRoShiRo::jump_table ().apply (S, actual) ;
+            XoRoShiRo::unsafe_jump (S) ;
+            CAPTURE (i) ;
+            REQUIRE (actual == S) ;
+            XoRoShiRo::unsafe_next (S) ;
+        }
+    }
+}
+
+#if CONTENTION_AVAILABLE
+
+TEST_CASE ("Test take_stream", "[substream]") {
+    SECTION ("Should return the shared state and jump it") {
+        alignas (16) XorShift::state_t  shared { 0, 1 } ;
+        XorShift::state_t   S { 0, 1 } ;
+        for (int_fast32_t i = 0 ; i < 10 ; ++i) {
+            REQUIRE (XorShift::take_stream (shared) == S) ;
+            XorShift::unsafe_jump (S) ;
+            REQUIRE (shared == S) ;
+        }
+    }
+
+    SECTION ("Concurrent callers should take each stream exactly once") {
+        const size_t    NUM_THREADS = 4 ;
+        const size_t    NUM_CALLS = 2000 ;
+        alignas (16) XoRoShiRo::state_t shared { 0, 1 } ;
+
+        std::vector<std::vector<XoRoShiRo::state_t>>    taken (NUM_THREADS) ;
+        std::vector<std::thread>    threads ;
+        for (size_t t = 0 ; t < NUM_THREADS ; ++t) {
+            threads.emplace_back ([&shared, &taken, t, NUM_CALLS]() {
+                for (size_t i = 0 ; i < NUM_CALLS ; ++i) {
+                    taken [t].push_back (XoRoShiRo::take_stream (shared)) ;
+                }
+            }) ;
+        }
+        for (auto &th : threads) {
+            th.join () ;
+        }
+
+        std::set<XoRoShiRo::state_t>    expected ;
+        XoRoShiRo::state_t  S { 0, 1 } ;
+        for (size_t i = 0 ; i < NUM_THREADS * NUM_CALLS ; ++i) {
+            expected.insert (S) ;
+            XoRoShiRo::unsafe_jump (S) ;
+        }
+        std::set<XoRoShiRo::state_t>    actual ;
+        for (const auto &v : taken) {
+            actual.insert (v.begin (), v.end ()) ;
+        }
+        REQUIRE (actual == expected) ;
+        REQUIRE (shared == S) ;
+    }
+}
+
+#endif  /* CONTENTION_AVAILABLE */
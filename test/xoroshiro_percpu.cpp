@@ -0,0 +1,69 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "xoroshiro_percpu.hpp"
+
+#if XOROSHIRO_LOCKFREE
+
+namespace {
+    /// Values drawn from every stream of `gen` (replays each one up to its current state).
+    std::vector<uint64_t>   replay (const XoRoShiRo::percpu_generator &gen, XoRoShiRo::state_t root, size_t limit) {
+        std::vector<uint64_t>   result ;
+        for (size_t i = 0 ; i <= gen.streams () ; ++i) {
+            XoRoShiRo::state_t  S = root ;
+            for (size_t k = 0 ; k < limit && S != gen.stream_state (i) ; ++k) {
+                result.push_back (XoRoShiRo::unsafe_next (S)) ;
+            }
+            REQUIRE (S == gen.stream_state (i)) ;
+            XoRoShiRo::unsafe_jump (root) ;
+        }
+        return result ;
+    }
+}
+
+TEST_CASE ("Test per-CPU xoroshiro128", "[xoroshiro][percpu]") {
+    const XoRoShiRo::state_t    root { 0, 1 } ;
+    const size_t    T = 4 ;
+    const size_t    N = 50000 ;
+
+    for (bool use_rseq : { true, false }) {
+        CAPTURE (use_rseq) ;
+        XoRoShiRo::percpu_generator gen { root, use_rseq } ;
+        REQUIRE (0 < gen.streams ()) ;
+        if (! use_rseq) {
+            REQUIRE_FALSE (gen.uses_rseq ()) ;
+        }
+
+        SECTION (use_rseq ? "Every drawn value should come from exactly one step of a stream (rseq)"
+                          : "Every drawn value should come from exactly one step of a stream (sched_getcpu + CAS)") {
+            std::vector<std::vector<uint64_t>>  drawn (T) ;
+            std::vector<std::thread>    threads ;
+            for (size_t t = 0 ; t < T ; ++t) {
+                threads.emplace_back ([&gen, &drawn, t, N]() {
+                    drawn [t].reserve (N) ;
+                    for (size_t i = 0 ; i < N ; ++i) {
+                        drawn [t].push_back (gen.next ()) ;
+                    }
+                }) ;
+            }
+            for (auto &th : threads) {
+                th.join () ;
+            }
+            std::vector<uint64_t>   actual ;
+            for (const auto &v : drawn) {
+                actual.insert (actual.end (), v.begin (), v.end ()) ;
+            }
+            auto    expected = replay (gen, root, T * N) ;
+            std::sort (actual.begin (), actual.end ()) ;
+            std::sort (expected.begin (), expected.end ()) ;
+            REQUIRE (actual == expected) ;
+        }
+    }
+}
+
+#endif
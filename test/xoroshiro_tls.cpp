@@ -0,0 +1,34 @@
+
+#include "catch.hpp"
+#include <stdint.h>
+
+#include <thread>
+
+#include "xoroshiro_tls.hpp"
+
+TEST_CASE ("Test thread-local xoroshiro128", "[xoroshiro][tls]") {
+    SECTION ("Each thread should take the root and jump it") {
+        XoRoShiRo::thread_state () ;    // Make sure the main thread's stream was split off already.
+
+        const XoRoShiRo::state_t    saved = XoRoShiRo::root_state () ;
+        XoRoShiRo::state_t          child { 0, 0 } ;
+        std::thread th { [&child]() { child = XoRoShiRo::thread_state () ; } } ;
+        th.join () ;
+
+        REQUIRE (child == saved) ;
+
+        XoRoShiRo::state_t  expected = saved ;
+        XoRoShiRo::unsafe_jump (expected) ;
+        REQUIRE (XoRoShiRo::root_state () == expected) ;
+    }
+
+    SECTION ("Value should follow the thread's own stream") {
+        XoRoShiRo::state_t  S = XoRoShiRo::thread_state () ;
+        for (int_fast32_t i = 0 ; i < 10000 ; ++i) {
+            auto expected = XoRoShiRo::unsafe_next (S) ;
+            auto actual = XoRoShiRo::thread_next () ;
+            CAPTURE (i) ;
+            REQUIRE (expected == actual) ;
+        }
+    }
+}
@@ -55,6 +55,12 @@ namespace {
     	s[0] = s0;
     	s[1] = s1;
     }
+
+    /// Constant expression friendly wrapper of `unsafe_jump`.
+    XORSHIFT_CONSTEXPR XorShift::state_t  jump_of (XorShift::state_t S) {
+        XorShift::unsafe_jump (S) ;
+        return S ;
+    }
 }
 
 TEST_CASE ("Test lockfree-xorshift128", "[xorshift]") {
@@ -115,5 +121,79 @@ TEST_CASE ("Test lock agnositic xorshift128", "[xorshift]") {
             REQUIRE (expected == actual) ;
         }
     }
+
+    SECTION ("Bulk fill should be equal to the reference implementation") {
+        s [0] = 0 ;
+        s [1] = 1 ;
+        alignas (16) XorShift::state_t state { 0, 1 } ;
+
+        uint64_t    values [1000] ;
+        for (int_fast32_t n = 0 ; n < 10 ; ++n) {
+            XorShift::unsafe_fill (state, values, 1000) ;
+            for (int_fast32_t i = 0 ; i < 1000 ; ++i) {
+                auto expected = next () ;
+                CAPTURE (i) ;
+                REQUIRE (expected == values [i]) ;
+            }
+        }
+    }
+
+    SECTION ("Interleaved fill should be equal to filling each lane alone") {
+        std::array<XorShift::state_t, 4>  lanes {} ;
+        XorShift::state_t S = XorShift::seed_state (42) ;
+        for (auto &L : lanes) {
+            L = S ;
+            XorShift::unsafe_jump (S) ;
+        }
+        auto    expected = lanes ;
+
+        uint64_t    values [4 * 250] ;
+        for (int_fast32_t n = 0 ; n < 4 ; ++n) {
+            XorShift::unsafe_fill_interleaved (lanes, values, 250) ;
+            for (size_t l = 0 ; l < 4 ; ++l) {
+                uint64_t    single [250] ;
+                XorShift::unsafe_fill (expected [l], single, 250) ;
+                for (size_t i = 0 ; i < 250 ; ++i) {
+                    CAPTURE (l) ;
+                    CAPTURE (i) ;
+                    REQUIRE (single [i] == values [i * 4 + l]) ;
+                }
+            }
+            REQUIRE (lanes == expected) ;
+        }
+    }
+
+    SECTION ("Tables should be equal to the reference implementation") {
+        s [0] = 0 ;
+        s [1] = 1 ;
+#if XORSHIFT_HAS_CONSTEXPR
+        constexpr auto  table = XorShift::make_table<1000> (XorShift::state_t { 0, 1 }) ;
+        static_assert (table [0] == 2, "Should be evaluated at compile time.") ;
+#else
+        const auto      table = XorShift::make_table<1000> (XorShift::state_t { 0, 1 }) ;
+#endif
+        for (int_fast32_t i = 0 ; i < 1000 ; ++i) {
+            auto expected = next () ;
+            CAPTURE (i) ;
+            REQUIRE (expected == table [i]) ;
+        }
+    }
+
+    SECTION ("Seeding and jump should be usable in constant expressions") {
+#if XORSHIFT_HAS_CONSTEXPR
+        constexpr auto  seeded = XorShift::seed_state (42) ;
+        constexpr auto  jumped = jump_of (seeded) ;
+#else
+        const auto      seeded = XorShift::seed_state (42) ;
+        const auto      jumped = jump_of (seeded) ;
+#endif
+        REQUIRE (seeded [0] == 0xBDD732262FEB6E95ull) ;
+        REQUIRE (seeded [1] == 0x28EFE333B266F103ull) ;
+        s [0] = seeded [0] ;
+        s [1] = seeded [1] ;
+        jump () ;
+        REQUIRE (jumped [0] == s [0]) ;
+        REQUIRE (jumped [1] == s [1]) ;
+    }
 }
 
@@ -0,0 +1,324 @@
+/*
+ * xorshift-cat.cpp: Writes generator output to stdout (or a file) at memory bandwidth.
+ *
+ * Output is a sequence of chunks; chunk i is produced by worker (i mod T) which draws
+ * from the root stream jumped (i mod T) times.  So the byte stream is a deterministic
+ * function of the seed, the generator, the # of workers and the chunk size.
+ *
+ * When stdout is a pipe (e.g. `xorshift-cat | RNG_test stdin64`), chunks are handed to
+ * the pipe with `vmsplice` (no copy into the pipe buffer).
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "xorshift.hpp"
+#include "xoroshiro.hpp"
+
+namespace {
+
+    const size_t    DEFAULT_CHUNK_SIZE = 1u << 20 ;
+    const size_t    BUFFERS_PER_WORKER = 4 ;
+    const uint64_t  UNLIMITED = UINT64_MAX ;
+
+    enum class generator_t { XORSHIFT, XOROSHIRO } ;
+
+    struct options_t {
+        generator_t generator = generator_t::XOROSHIRO ;
+        uint64_t    seed = 0 ;
+        uint64_t    bytes = UNLIMITED ;
+        size_t      threads = 0 ;
+        size_t      chunk_size = DEFAULT_CHUNK_SIZE ;
+        std::string output ;
+    } ;
+
+    /// Page aligned buffer.
+    struct buffer_t {
+        uint8_t *   data = nullptr ;
+        size_t      size = 0 ;      // # of valid bytes.
+        bool        full = false ;
+    } ;
+
+    struct worker_t {
+        std::mutex              lock ;
+        std::condition_variable cond ;
+        std::vector<buffer_t>   buffers ;
+        std::thread             thread ;
+    } ;
+
+    class cat_t {
+    private:
+        options_t   opt_ ;
+        std::vector<std::unique_ptr<worker_t>>  workers_ ;
+        std::atomic<bool>   stop_ { false } ;
+        uint64_t            num_chunks_ ;
+    public:
+        explicit cat_t (const options_t &opt) : opt_ (opt) {
+            num_chunks_ = opt.bytes == UNLIMITED ? UINT64_MAX : (opt.bytes + opt.chunk_size - 1) / opt.chunk_size ;
+        }
+
+        ~cat_t () {
+            stop_.store (true) ;
+            for (auto &w : workers_) {
+                {
+                    std::lock_guard<std::mutex> guard (w->lock) ;
+                }
+                w->cond.notify_all () ;
+                if (w->thread.joinable ()) {
+                    w->thread.join () ;
+                }
+                for (auto &b : w->buffers) {
+                    free (b.data) ;
+                }
+            }
+        }
+
+        int run (int fd) {
+            const size_t    T = opt_.threads ;
+            auto    root = XoRoShiRo::seed_state (opt_.seed) ;
+            for (size_t t = 0 ; t < T ; ++t) {
+                std::unique_ptr<worker_t>   w { new worker_t } ;
+                w->buffers.resize (BUFFERS_PER_WORKER) ;
+                for (auto &b : w->buffers) {
+                    if (posix_memalign (reinterpret_cast<void **> (&b.data), 4096, opt_.chunk_size) != 0) {
+                        fprintf (stderr, "xorshift-cat: Out of memory\n") ;
+                        return 1 ;
+                    }
+                }
+                workers_.push_back (std::move (w)) ;
+            }
+            for (size_t t = 0 ; t < T ; ++t) {
+                workers_ [t]->thread = std::thread { [this, t, root]() { produce (t, root) ; } } ;
+                if (opt_.generator == generator_t::XORSHIFT) {
+                    XorShift::unsafe_jump (root) ;
+                }
+                else {
+                    XoRoShiRo::unsafe_jump (root) ;
+                }
+            }
+            return consume (fd) ;
+        }
+    private:
+        /// Worker `t` fills chunks t, t + T, t + 2T, ... in order.
+        void    produce (size_t t, std::array<uint64_t, 2> state) {
+            const size_t    T = opt_.threads ;
+            worker_t &      w = *workers_ [t] ;
+            uint64_t        k = 0 ;     // # of chunks produced by this worker.
+            for (uint64_t chunk = t ; chunk < num_chunks_ ; chunk += T, ++k) {
+                buffer_t &  b = w.buffers [k % BUFFERS_PER_WORKER] ;
+                {
+                    std::unique_lock<std::mutex>    guard (w.lock) ;
+                    w.cond.wait (guard, [this, &b]() { return ! b.full || stop_.load () ; }) ;
+                    if (stop_.load ()) {
+                        return ;
+                    }
+                }
+                const size_t    n = (opt_.chunk_size + sizeof (uint64_t) - 1) / sizeof (uint64_t) ;
+                if (opt_.generator == generator_t::XORSHIFT) {
+                    XorShift::unsafe_fill (state, reinterpret_cast<uint64_t *> (b.data), n) ;
+                }
+                else {
+                    XoRoShiRo::unsafe_fill (state, reinterpret_cast<uint64_t *> (b.data), n) ;
+                }
+                size_t  size = opt_.chunk_size ;
+                if (opt_.bytes != UNLIMITED && chunk == num_chunks_ - 1 && opt_.bytes % opt_.chunk_size != 0) {
+                    size = static_cast<size_t> (opt_.bytes % opt_.chunk_size) ;
+                }
+                {
+                    std::lock_guard<std::mutex> guard (w.lock) ;
+                    b.size = size ;
+                    b.full = true ;
+                }
+                w.cond.notify_all () ;
+            }
+        }
+
+        void    release (uint64_t chunk) {
+            worker_t &  w = *workers_ [chunk % opt_.threads] ;
+            {
+                std::lock_guard<std::mutex> guard (w.lock) ;
+                w.buffers [(chunk / opt_.threads) % BUFFERS_PER_WORKER].full = false ;
+            }
+            w.cond.notify_all () ;
+        }
+
+        int consume (int fd) {
+            struct stat st ;
+            const bool  is_pipe = fstat (fd, &st) == 0 && S_ISFIFO (st.st_mode) ;
+            bool        use_vmsplice = false ;
+#if defined (__linux__)
+            if (is_pipe) {
+                // A chunk spliced into a pipe stays referenced until the reader consumed it.  Sizing the pipe to
+                // one chunk guarantees the previous chunk was consumed once the current one is fully spliced.
+                fcntl (fd, F_SETPIPE_SZ, static_cast<int> (opt_.chunk_size)) ;
+                use_vmsplice = fcntl (fd, F_GETPIPE_SZ) == static_cast<int> (opt_.chunk_size) ;
+            }
+#endif
+            for (uint64_t chunk = 0 ; chunk < num_chunks_ ; ++chunk) {
+                worker_t &  w = *workers_ [chunk % opt_.threads] ;
+                buffer_t &  b = w.buffers [(chunk / opt_.threads) % BUFFERS_PER_WORKER] ;
+                {
+                    std::unique_lock<std::mutex>    guard (w.lock) ;
+                    w.cond.wait (guard, [&b]() { return b.full ; }) ;
+                }
+                if (! emit (fd, b.data, b.size, use_vmsplice)) {
+                    return errno == EPIPE ? 0 : 1 ;
+                }
+                if (! use_vmsplice) {
+                    release (chunk) ;
+                }
+                else if (0 < chunk) {
+                    release (chunk - 1) ;
+                }
+            }
+            return 0 ;
+        }
+
+        static bool emit (int fd, const uint8_t *data, size_t size, bool use_vmsplice) {
+            while (0 < size) {
+                ssize_t n ;
+#if defined (__linux__)
+                if (use_vmsplice) {
+                    struct iovec    iov { const_cast<uint8_t *> (data), size } ;
+                    n = vmsplice (fd, &iov, 1, 0) ;
+                }
+                else
+#endif
+                {
+                    (void)use_vmsplice ;
+                    n = write (fd, data, size) ;
+                }
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue ;
+                    }
+                    if (errno != EPIPE) {
+                        perror ("xorshift-cat") ;
+                    }
+                    return false ;
+                }
+                data += n ;
+                size -= static_cast<size_t> (n) ;
+            }
+            return true ;
+        }
+    } ;
+
+    /// Parses a byte count with an optional K/M/G/T suffix (powers of 1024).
+    bool    parse_size (const char *s, uint64_t &result) {
+        char *  end = nullptr ;
+        errno = 0 ;
+        uint64_t    v = strtoull (s, &end, 0) ;
+        if (errno != 0 || end == s) {
+            return false ;
+        }
+        switch (*end) {
+        case 'T': case 't': v <<= 10 ; /* FALLTHROUGH */
+        case 'G': case 'g': v <<= 10 ; /* FALLTHROUGH */
+        case 'M': case 'm': v <<= 10 ; /* FALLTHROUGH */
+        case 'K': case 'k': v <<= 10 ; ++end ; break ;
+        default: break ;
+        }
+        if (*end != 0) {
+            return false ;
+        }
+        result = v ;
+        return true ;
+    }
+
+    void    usage (const char *prog) {
+        fprintf (stderr,
+                 "Usage: %s [options]\n"
+                 "  -g, --generator NAME   xoroshiro (default) or xorshift\n"
+                 "  -s, --seed N           Seed (default: 0)\n"
+                 "  -n, --bytes N[KMGT]    # of bytes to write (default: unlimited)\n"
+                 "  -t, --threads N        # of generator threads (default: hardware concurrency)\n"
+                 "  -c, --chunk N[KMG]     Chunk size (default: 1M, multiple of 4096)\n"
+                 "  -o, --output FILE      Writes to FILE instead of stdout\n",
+                 prog) ;
+    }
+}
+
+int main (int argc, char **argv) {
+    options_t   opt ;
+    for (int i = 1 ; i < argc ; ++i) {
+        const char *    a = argv [i] ;
+        auto    is = [a](const char *s, const char *l) { return strcmp (a, s) == 0 || strcmp (a, l) == 0 ; } ;
+        if (argc <= i + 1) {
+            usage (argv [0]) ;
+            return 1 ;
+        }
+        const char *    v = argv [++i] ;
+        uint64_t        n = 0 ;
+        if (is ("-g", "--generator")) {
+            if (strcmp (v, "xorshift") == 0) {
+                opt.generator = generator_t::XORSHIFT ;
+            }
+            else if (strcmp (v, "xoroshiro") == 0) {
+                opt.generator = generator_t::XOROSHIRO ;
+            }
+            else {
+                usage (argv [0]) ;
+                return 1 ;
+            }
+        }
+        else if (is ("-s", "--seed") && parse_size (v, n)) {
+            opt.seed = n ;
+        }
+        else if (is ("-n", "--bytes") && parse_size (v, n)) {
+            opt.bytes = n ;
+        }
+        else if (is ("-t", "--threads") && parse_size (v, n)) {
+            opt.threads = static_cast<size_t> (n) ;
+        }
+        else if (is ("-c", "--chunk") && parse_size (v, n) && 0 < n && n % 4096 == 0) {
+            opt.chunk_size = static_cast<size_t> (n) ;
+        }
+        else if (is ("-o", "--output")) {
+            opt.output = v ;
+        }
+        else {
+            usage (argv [0]) ;
+            return 1 ;
+        }
+    }
+    if (opt.threads == 0) {
+        opt.threads = std::max<size_t> (1, std::thread::hardware_concurrency ()) ;
+    }
+    if (opt.bytes == 0) {
+        return 0 ;
+    }
+
+    signal (SIGPIPE, SIG_IGN) ;
+    int fd = STDOUT_FILENO ;
+    if (! opt.output.empty ()) {
+        fd = open (opt.output.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644) ;
+        if (fd < 0) {
+            perror (opt.output.c_str ()) ;
+            return 1 ;
+        }
+    }
+    int result = cat_t { opt }.run (fd) ;
+    if (fd != STDOUT_FILENO && close (fd) != 0) {
+        perror (opt.output.c_str ()) ;
+        result = 1 ;
+    }
+    return result ;
+}